@@ -18,6 +18,7 @@ extern "C" {
 #endif
 
 #include "h264decoder.hpp"
+#include <exception>
 #include <utility>
 
 typedef unsigned char ubyte;
@@ -45,6 +46,13 @@ H264Decoder::H264Decoder()
     context->flags |= CODEC_FLAG_TRUNCATED;
   }
 
+#if LIBAVCODEC_VERSION_MAJOR < 59
+  /* Hand out frames that own reference counted buffers, so that consumers
+  can keep a frame with av_frame_ref() instead of copying it. Always on in
+  newer releases. */
+  context->refcounted_frames = 1;
+#endif
+
   int err = avcodec_open2(context, codec, nullptr);
   if (err < 0)
     throw H264InitFailure("cannot open context");
@@ -93,9 +101,35 @@ bool H264Decoder::is_frame_available() const
 }
 
 
+bool H264Decoder::is_keyframe() const
+{
+  return parser->key_frame == 1;
+}
+
+
+const ubyte* H264Decoder::packet_data() const
+{
+  return pkt->data;
+}
+
+
+int H264Decoder::packet_size() const
+{
+  return pkt->size;
+}
+
+
+void H264Decoder::set_keyframes_only(bool keyframes_only)
+{
+  context->skip_frame = keyframes_only ? AVDISCARD_NONKEY : AVDISCARD_DEFAULT;
+}
+
+
 const AVFrame& H264Decoder::decode_frame()
 {
   int got_picture = 0;
+  /* Drop our reference to the previous frame, consumers keep theirs */
+  av_frame_unref(frame);
   int nread = avcodec_decode_video2(context, frame, &got_picture, pkt);
   if (nread < 0 || got_picture == 0)
     throw H264DecodeFailure("error decoding frame\n");
@@ -103,41 +137,198 @@ const AVFrame& H264Decoder::decode_frame()
 }
 
 
+int H264Decoder::stream_width() const
+{
+  return parser->width;
+}
+
+
+int H264Decoder::stream_height() const
+{
+  return parser->height;
+}
+
+
 ConverterRGB24::ConverterRGB24()
 {
   framergb = av_frame_alloc();
   if (!framergb)
     throw H264DecodeFailure("cannot allocate frame");
   context = nullptr;
+  rgb = false;
+  work_frame = nullptr;
+  work_generation = 0;
+  work_pending = 0;
+  stopping = false;
 }
 
 ConverterRGB24::~ConverterRGB24()
 {
+  stop_workers();
+  for (auto &stripe : stripes)
+    sws_freeContext(stripe.context);
   sws_freeContext(context);
   av_frame_free(&framergb);
 }
 
 
+void ConverterRGB24::set_stripes(int n)
+{
+  stop_workers();
+  for (auto &stripe : stripes)
+    sws_freeContext(stripe.context);
+  stripes.clear();
+
+  if (n <= 1)
+    return;
+
+  stripes.resize(n, Stripe{nullptr, 0, 0});
+  stopping = false;
+  for (size_t i = 1; i < stripes.size(); ++i)
+    workers.emplace_back(&ConverterRGB24::worker, this, i, work_generation);
+}
+
+
+void ConverterRGB24::set_rgb(bool rgb_)
+{
+  // sws_getCachedContext() notices the new format
+  rgb = rgb_;
+}
+
+
+void ConverterRGB24::stop_workers()
+{
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    stopping = true;
+  }
+  work_cv.notify_all();
+  for (auto &worker : workers)
+    worker.join();
+  workers.clear();
+}
+
+
+/* Stripes must start on even rows, YUV420P chroma rows cover 2 luma rows. */
+void ConverterRGB24::layout_stripes(int h)
+{
+  int n = static_cast<int>(stripes.size());
+  int rows = ((h + n - 1) / n + 1) & ~1;
+  int y = 0;
+  for (auto &stripe : stripes) {
+    stripe.y = y < h ? y : h;
+    stripe.h = y + rows < h ? rows : h - stripe.y;
+    y += rows;
+  }
+}
+
+
+void ConverterRGB24::convert_stripe(Stripe &stripe)
+{
+  if (stripe.h <= 0)
+    return;
+
+  const AVFrame &frame = *work_frame;
+  int w = frame.width;
+
+  stripe.context = sws_getCachedContext(stripe.context,
+    w, stripe.h, (AVPixelFormat)frame.format,
+    w, stripe.h, rgb ? AV_PIX_FMT_RGB24 : AV_PIX_FMT_BGR24, SWS_BILINEAR,
+    nullptr, nullptr, nullptr);
+  if (!stripe.context)
+    throw H264DecodeFailure("cannot allocate context");
+
+  const ubyte *src[3] = {
+    frame.data[0] + stripe.y * frame.linesize[0],
+    frame.data[1] + stripe.y / 2 * frame.linesize[1],
+    frame.data[2] + stripe.y / 2 * frame.linesize[2]};
+  ubyte *dst[1] = {framergb->data[0] + stripe.y * framergb->linesize[0]};
+  int dst_linesize[1] = {framergb->linesize[0]};
+
+  sws_scale(stripe.context, src, frame.linesize, 0, stripe.h, dst, dst_linesize);
+}
+
+
+void ConverterRGB24::worker(size_t index, unsigned seen)
+{
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      work_cv.wait(lock, [this, seen]() { return stopping || work_generation != seen; });
+      if (stopping)
+        return;
+      seen = work_generation;
+    }
+
+    // Errors are rare (allocation failure), hand them to convert() rather than kill the thread
+    std::exception_ptr error;
+    try {
+      convert_stripe(stripes[index]);
+    } catch (...) {
+      error = std::current_exception();
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      if (error && !work_error)
+        work_error = error;
+      if (--work_pending == 0)
+        done_cv.notify_one();
+    }
+  }
+}
+
+
 const AVFrame& ConverterRGB24::convert(const AVFrame &frame, ubyte* out_rgb)
 {
   int w = frame.width;
   int h = frame.height;
   int pix_fmt = frame.format;
 
+  // Setup framergb with out_rgb as external buffer. Also say that we want RGB24 output.
+  avpicture_fill((AVPicture*)framergb, out_rgb, rgb ? AV_PIX_FMT_RGB24 : AV_PIX_FMT_BGR24, w, h);
+  framergb->width = w;
+  framergb->height = h;
+
+  // Striped conversion: hand stripes 1..n-1 to the workers, do stripe 0 here, wait for the rest.
+  if (!stripes.empty() && (pix_fmt == AV_PIX_FMT_YUV420P || pix_fmt == AV_PIX_FMT_YUVJ420P)) {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      layout_stripes(h);
+      work_frame = &frame;
+      work_pending = static_cast<int>(workers.size());
+      work_error = nullptr;
+      ++work_generation;
+    }
+    work_cv.notify_all();
+
+    // The workers are using frame and out_rgb, so wait for them even if stripe 0 fails
+    std::exception_ptr error;
+    try {
+      convert_stripe(stripes[0]);
+    } catch (...) {
+      error = std::current_exception();
+    }
+
+    std::unique_lock<std::mutex> lock(mtx);
+    done_cv.wait(lock, [this]() { return work_pending == 0; });
+    if (!error)
+      error = work_error;
+    if (error)
+      std::rethrow_exception(error);
+    return *framergb;
+  }
+
+  // Do the conversion.
   context = sws_getCachedContext(context,
     w, h, (AVPixelFormat)pix_fmt,
-    w, h, AV_PIX_FMT_BGR24, SWS_BILINEAR,
+    w, h, rgb ? AV_PIX_FMT_RGB24 : AV_PIX_FMT_BGR24, SWS_BILINEAR,
     nullptr, nullptr, nullptr);
   if (!context)
     throw H264DecodeFailure("cannot allocate context");
 
-  // Setup framergb with out_rgb as external buffer. Also say that we want RGB24 output.
-  avpicture_fill((AVPicture*)framergb, out_rgb, AV_PIX_FMT_BGR24, w, h);
-  // Do the conversion.
   sws_scale(context, frame.data, frame.linesize, 0, h,
     framergb->data, framergb->linesize);
-  framergb->width = w;
-  framergb->height = h;
   return *framergb;
 }
 
@@ -19,6 +19,11 @@ mechanisms of boost::python.
 // for ssize_t (signed int type as large as pointer type)
 #include <cstdlib>
 #include <stdexcept>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 struct AVCodecContext;
 struct AVFrame;
@@ -71,7 +76,23 @@ bytes at frame boundaries.
   */
   ssize_t parse(const unsigned char* in_data, ssize_t in_size);
   bool is_frame_available() const;
+  /* True if the most recently parsed frame is a keyframe (IDR or
+recovery point). */
+  bool is_keyframe() const;
+  /* The most recently parsed access unit, Annex B, valid until the
+next call to parse(). */
+  const unsigned char* packet_data() const;
+  int packet_size() const;
+  /* The frame is reference counted, av_frame_ref() shares its buffers
+instead of copying the pixels. Valid until the next call. */
   const AVFrame& decode_frame();
+  /* Tell the decoder to discard everything except keyframes. Callers
+should also skip decode_frame() for frames that aren't keyframes. */
+  void set_keyframes_only(bool keyframes_only);
+  /* Stream dimensions from the most recent SPS seen by the parser,
+or 0 if no SPS has been parsed yet. */
+  int stream_width() const;
+  int stream_height() const;
 };
 
 // TODO: Rename to OutputStage or so?!
@@ -79,11 +100,45 @@ class ConverterRGB24
 {
   SwsContext *context;
   AVFrame *framergb;
+  bool rgb;
+
+  /* Row striping: the frame is split into horizontal stripes, each
+with its own sws context. Stripe 0 is converted by the calling thread,
+the others by a persistent pool of worker threads. Chroma is not
+interpolated across stripe boundaries, the difference is not visible. */
+  struct Stripe
+  {
+    SwsContext *context;
+    int y;
+    int h;
+  };
+  std::vector<Stripe> stripes;
+  std::vector<std::thread> workers;
+  std::mutex mtx;
+  std::condition_variable work_cv;
+  std::condition_variable done_cv;
+  const AVFrame *work_frame;
+  unsigned work_generation;
+  int work_pending;
+  std::exception_ptr work_error;  /* First stripe failure of this frame, rethrown by convert() */
+  bool stopping;
+
+  void layout_stripes(int h);
+  void convert_stripe(Stripe &stripe);
+  void worker(size_t index, unsigned seen);
+  void stop_workers();
 
 public:
   ConverterRGB24();
   ~ConverterRGB24();
 
+  /*  Convert using n horizontal stripes in parallel, n = 1 converts
+      on the calling thread. Not safe to call during convert(). */
+  void set_stripes(int n);
+
+  /*  Output RGB24 instead of BGR24. Not safe to call during convert(). */
+  void set_rgb(bool rgb);
+
   /*  Returns, given a width and height,
       how many bytes the frame buffer is going to need. */
   int predict_size(int w, int h);
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tello_core.hpp"
+
+namespace tello_driver
+{
+
+  //=====================================================================================
+  // Black box, no ROS required
+  //
+  // Keeps the last few seconds of compressed video and raw state packets in memory,
+  // bounded by bytes and by time. Video is evicted a GOP at a time, so the buffer always
+  // starts on a keyframe. The most recent GOP is never evicted, if it alone is over the
+  // byte budget the telemetry is only evicted by time.
+  //
+  // dump() snapshots the buffer (pointer copies, the access units are shared) and writes
+  // an MP4 and a telemetry CSV on a background thread, so the live pipeline never waits
+  // for the disk. Timestamps in both files count from the first access unit.
+  //
+  // Dumps can also be triggered by the state packets: an acceleration spike (a crash)
+  // or the battery dropping below a threshold.
+  //=====================================================================================
+
+  class BlackBox
+  {
+  public:
+
+    using Log = std::function<void(LogLevel level, const std::string &msg)>;
+
+    struct Config
+    {
+      size_t max_bytes;           // Video and telemetry bytes to keep
+      double max_seconds;         // Seconds to keep
+      std::string dir;            // Write dumps to this directory
+      double crash_accel;         // Dump if |(agx, agy, agz)| exceeds this, 0 to disable
+      int low_battery;            // Dump if bat drops below this, 0 to disable
+    };
+
+    enum class Result
+    {
+      ok,                         // Writing in the background
+      empty,                      // No keyframe recorded yet
+      busy,                       // Another dump is being written
+    };
+
+    BlackBox(const Config &config, Log log);
+
+    // Waits for a dump in progress
+    ~BlackBox();
+
+    // Called by the core video thread
+    void on_access_unit(const AccessUnit &au, CoreClock::time_point time);
+
+    // Called by the core state thread, checks the triggers
+    void on_state(const std::string &raw, CoreClock::time_point time);
+
+    // Snapshot the buffer and write it in the background, fills in the file paths
+    Result dump(const std::string &reason, std::string &video_path, std::string &telemetry_path);
+
+  private:
+
+    struct Unit
+    {
+      std::shared_ptr<const std::vector<unsigned char>> data;
+      bool keyframe;
+      CoreClock::time_point time;
+    };
+
+    struct State
+    {
+      std::string raw;
+      CoreClock::time_point time;
+    };
+
+    // mtx_ must be held
+    void evict(CoreClock::time_point now);
+
+    void check_triggers(const std::string &raw);
+
+    void write(std::deque<Unit> units, std::deque<State> states, int width, int height,
+               std::string video_path, std::string telemetry_path);
+
+    bool write_video(const std::deque<Unit> &units, int width, int height, const std::string &path);
+
+    bool write_telemetry(const std::deque<State> &states, CoreClock::time_point start, const std::string &path);
+
+    Config config_;
+    Log log_;
+
+    std::mutex mtx_;
+    std::deque<Unit> units_;          // Starts on a keyframe
+    std::deque<State> states_;
+    size_t bytes_ = 0;                // Video and telemetry
+    size_t video_bytes_ = 0;
+    int width_ = 0;                   // Stream dimensions at the most recent keyframe
+    int height_ = 0;
+
+    // Triggers, used by the state thread
+    bool crashed_ = false;            // Re-armed when the acceleration spike is over
+    bool battery_low_ = false;        // Fires once per flight, re-armed if bat rises again
+
+    std::mutex dump_mtx_;             // dump() is called by the state thread and by the driver
+    std::atomic<bool> writing_{false};
+    std::thread writer_;
+  };
+
+} // namespace tello_driver
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tello_driver
+{
+
+  //=====================================================================================
+  // Command scheduler
+  //
+  // Calls fire() at an absolute CLOCK_REALTIME time, shared by all drivers in a process.
+  //
+  // Entries are kept in a timer wheel with 1ms slots, entries beyond the wheel horizon
+  // wait in an overflow map. A single thread, SCHED_FIFO if the process is allowed,
+  // sleeps on a condition variable until a slot's tick arrives, takes the slot, then
+  // uses clock_nanosleep and spins for the last few microseconds before each entry.
+  // The cursor never moves past the current tick, so an entry scheduled after a later
+  // one still lands in its own slot.
+  //
+  // fire() must be fast, e.g., a UDP send, and returns false if nothing was sent. report()
+  // is called after all entries in the same 1ms slot have fired, with the achieved time.
+  //=====================================================================================
+
+  class CommandScheduler
+  {
+  public:
+
+    using Fire = std::function<bool()>;
+    using Report = std::function<void(bool sent, int64_t actual_ns)>;
+
+    // The process-wide scheduler, the thread starts on first use
+    static CommandScheduler &instance();
+
+    ~CommandScheduler();
+
+    // Current CLOCK_REALTIME time in nanoseconds
+    static int64_t now_ns();
+
+    // Schedule fire() at target_ns, owner is used to cancel
+    void schedule(const void *owner, int64_t target_ns, Fire fire, Report report);
+
+    // Drop all pending entries for owner, including entries in the batch being fired,
+    // waits for a fire() or report() for owner that is running right now
+    void cancel(const void *owner);
+
+    // True if the scheduler thread runs with a real-time priority
+    bool realtime() const { return realtime_; }
+
+  private:
+
+    struct Entry
+    {
+      const void *owner;
+      int64_t target_ns;
+      Fire fire;
+      Report report;
+      bool canceled = false;
+    };
+
+    CommandScheduler();
+
+    void insert(Entry &&entry);
+
+    void run();
+
+    // Fire the batch, mtx_ must be held, it is released while sleeping and calling out
+    void fire_batch(std::unique_lock<std::mutex> &lock);
+
+    std::mutex mtx_;
+    std::condition_variable cv_;          // Signaled on schedule() and stop
+    std::condition_variable idle_cv_;     // Signaled when a call to fire() or report() returns
+    std::vector<std::vector<Entry>> wheel_;
+    std::multimap<int64_t, Entry> overflow_;
+    int64_t cursor_tick_;                 // Tick of the first slot that may hold entries, never past now
+    size_t wheel_count_ = 0;              // Entries in the wheel
+    std::vector<Entry> batch_;            // Taken from the wheel, being fired, cancel() marks entries
+    const void *calling_ = nullptr;       // Owner whose fire() or report() is running
+    bool stopping_ = false;
+    bool realtime_ = false;
+    std::thread thread_;
+  };
+
+} // namespace tello_driver
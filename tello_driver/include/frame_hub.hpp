@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+
+struct AVFrame;
+
+namespace tello_driver
+{
+
+  //=====================================================================================
+  // Frame hub, no ROS required
+  //
+  // Hands decoded frames to other components in the same process, shared by all drivers
+  // in a process. Lives in tello_core so that every component library sees one instance.
+  //
+  // Listeners are called on the publisher's video thread, and must only take a reference
+  // to the frame (av_frame_ref, which shares the decoder's reference counted buffers) and
+  // return. Listeners are called with the hub mutex held, so remove_listener() waits for
+  // calls in progress.
+  //
+  // A listener only gets frames while it wants them, e.g., while its output has
+  // subscribers. Publishers skip publish() entirely if no listener wants frames.
+  //=====================================================================================
+
+  class FrameHub
+  {
+  public:
+
+    // source identifies the publisher, e.g., the driver's fully qualified node name
+    using Listener = std::function<void(const std::string &source, const AVFrame &frame)>;
+
+    // The process-wide hub
+    static FrameHub &instance();
+
+    // Returns an id for remove_listener() and set_wanted(), the listener doesn't want frames yet
+    int add_listener(Listener listener);
+
+    void remove_listener(int id);
+
+    void set_wanted(int id, bool wanted);
+
+    // Cheap check, publishers skip publish() if no listener wants frames
+    bool wanted() const { return wanted_count_ > 0; }
+
+    void publish(const std::string &source, const AVFrame &frame);
+
+  private:
+
+    FrameHub() = default;
+
+    struct Entry
+    {
+      Listener listener;
+      bool wanted;
+    };
+
+    // mtx_ must be held
+    void count_wanted();
+
+    std::mutex mtx_;
+    std::map<int, Entry> listeners_;
+    int next_id_ = 0;
+    std::atomic<int> wanted_count_{0};
+  };
+
+} // namespace tello_driver
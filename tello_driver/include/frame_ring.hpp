@@ -0,0 +1,147 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace tello_driver
+{
+
+  //=====================================================================================
+  // Shared memory frame ring
+  //
+  // One writer (the driver) publishes decoded frames into a POSIX shared memory object,
+  // any number of readers in other processes map the latest frame without copying.
+  //
+  // Layout, all integers are little endian:
+  //
+  //    Ring header, 64 bytes:
+  //      0  uint32 magic           FRAME_RING_MAGIC
+  //      4  uint32 version         FRAME_RING_VERSION
+  //      8  uint32 num_slots
+  //     12  uint32 slot_size       Capacity of each slot in bytes, not including the slot header
+  //     16  uint64 slot_stride     Distance between slot headers, a multiple of the page size
+  //     24  uint64 frame_count     Frames published, the latest is in slot (frame_count - 1) % num_slots
+  //     32  uint32 state           FRAME_RING_OPEN, or FRAME_RING_CLOSED if readers should re-open
+  //
+  //    Slot i header, 64 bytes, at 64 + i * slot_stride:
+  //      0  uint64 seq             Seqlock, odd while the writer is writing
+  //      8  uint64 frame_number
+  //     16  int64  stamp_ns        ROS header stamp
+  //     24  int64  write_ns        CLOCK_MONOTONIC time the slot was published
+  //     32  uint32 width
+  //     36  uint32 height
+  //     40  uint32 step            Bytes per row
+  //     44  char   encoding[20]    sensor_msgs/image_encodings name, e.g., "bgr8"
+  //
+  //    Slot i pixels follow the slot header.
+  //
+  // Readers must check that seq is even before reading, and unchanged after reading.
+  // The writer cycles through the slots, so a reader has num_slots - 1 frame times to finish.
+  //=====================================================================================
+
+  constexpr uint32_t FRAME_RING_MAGIC = 0x47524654;     // "TFRG"
+  constexpr uint32_t FRAME_RING_VERSION = 1;
+  constexpr uint32_t FRAME_RING_OPEN = 1;
+  constexpr uint32_t FRAME_RING_CLOSED = 2;
+
+  struct FrameRingHeader
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_slots;
+    uint32_t slot_size;
+    uint64_t slot_stride;
+    std::atomic<uint64_t> frame_count;
+    std::atomic<uint32_t> state;
+    uint8_t reserved[28];
+  };
+
+  struct FrameSlotHeader
+  {
+    std::atomic<uint64_t> seq;
+    uint64_t frame_number;
+    int64_t stamp_ns;
+    int64_t write_ns;
+    uint32_t width;
+    uint32_t height;
+    uint32_t step;
+    char encoding[20];
+  };
+
+  static_assert(sizeof(FrameRingHeader) == 64, "FrameRingHeader layout");
+  static_assert(sizeof(FrameSlotHeader) == 64, "FrameSlotHeader layout");
+  static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared memory atomics must be lock free");
+
+  class FrameRingWriter
+  {
+  public:
+
+    // Create (or replace) the shared memory object /name
+    FrameRingWriter(const std::string &name, uint32_t num_slots, uint32_t slot_size);
+
+    // Mark the ring closed and unlink it, mapped readers keep working but see no new frames
+    ~FrameRingWriter();
+
+    uint32_t slot_size() const
+    { return header_->slot_size; }
+
+    // Claim the next slot, returns a pointer to slot_size() bytes; repeated calls return the same slot
+    uint8_t *begin_write();
+
+    // Publish the claimed slot
+    void end_write(uint32_t width, uint32_t height, uint32_t step, const std::string &encoding, int64_t stamp_ns);
+
+  private:
+
+    std::string name_;
+    size_t size_;
+    uint8_t *base_;
+    FrameRingHeader *header_;
+    FrameSlotHeader *slot_ = nullptr;   // Claimed slot
+  };
+
+  // Zero-copy view of a frame in the ring, valid until the writer reuses the slot
+  struct FrameView
+  {
+    const FrameSlotHeader *slot;
+    uint64_t seq;
+    const uint8_t *data;
+    uint64_t frame_number;
+    int64_t stamp_ns;
+    int64_t write_ns;
+    uint32_t width;
+    uint32_t height;
+    uint32_t step;
+    std::string encoding;
+  };
+
+  class FrameRingReader
+  {
+  public:
+
+    // Map the shared memory object /name, throws std::runtime_error if it doesn't exist
+    explicit FrameRingReader(const std::string &name);
+
+    ~FrameRingReader();
+
+    // Frames published so far
+    uint64_t frame_count() const;
+
+    // True if the writer has replaced or closed the ring, re-open to continue
+    bool closed() const;
+
+    // Map the latest frame, returns false if there are no frames or the writer is busy with the slot
+    bool latest(FrameView &view) const;
+
+    // True if the writer has not touched the frame since latest() returned it
+    bool still_valid(const FrameView &view) const;
+
+  private:
+
+    size_t size_;
+    const uint8_t *base_;
+    const FrameRingHeader *header_;
+  };
+
+} // namespace tello_driver
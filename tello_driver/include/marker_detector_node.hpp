@@ -0,0 +1,52 @@
+#include "rclcpp/rclcpp.hpp"
+#include "sensor_msgs/msg/camera_info.hpp"
+#include "sensor_msgs/msg/image.hpp"
+#include "tello_msgs/msg/marker_poses.hpp"
+
+#include <opencv2/aruco.hpp>
+
+namespace tello_marker
+{
+
+  // ArUco marker detector:
+  // -- subscribe to the driver's image_gray topic (the Y plane of the decoded frame)
+  // -- detect markers, optionally on a decimated copy first, then refine corners at full resolution
+  // -- publish marker poses in the camera frame
+  //
+  // Run in the same container as the driver with use_intra_process_comms=true, the driver
+  // publishes a unique_ptr and this node takes ownership, so the Y plane is copied once.
+
+  class MarkerDetectorNode : public rclcpp::Node
+  {
+  public:
+
+    explicit MarkerDetectorNode(const rclcpp::NodeOptions &options);
+
+    ~MarkerDetectorNode();
+
+  private:
+
+    void camera_info_callback(const sensor_msgs::msg::CameraInfo::SharedPtr msg);
+
+    void image_callback(sensor_msgs::msg::Image::UniquePtr msg);
+
+    void detect(const cv::Mat &gray, std::vector<int> &ids, std::vector<std::vector<cv::Point2f>> &corners);
+
+    rclcpp::Subscription<sensor_msgs::msg::CameraInfo>::SharedPtr camera_info_sub_;
+    rclcpp::Subscription<sensor_msgs::msg::Image>::SharedPtr image_sub_;
+    rclcpp::Publisher<tello_msgs::msg::MarkerPoses>::SharedPtr marker_poses_pub_;
+
+    double marker_length_;
+    int decimate_;
+
+    cv::Ptr<cv::aruco::Dictionary> dictionary_;
+    cv::Ptr<cv::aruco::DetectorParameters> detector_params_;
+
+    bool have_camera_info_ = false;
+    cv::Matx33d camera_matrix_;
+    std::vector<double> dist_coeffs_;
+
+    cv::Mat decimated_;                     // Reused for the decimated pre-pass
+  };
+
+} // namespace tello_marker
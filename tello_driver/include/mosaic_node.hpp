@@ -0,0 +1,71 @@
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+#include "sensor_msgs/msg/image.hpp"
+
+struct AVFrame;
+struct SwsContext;
+
+namespace tello_mosaic
+{
+
+  // Video mosaic for a swarm:
+  // -- take references to the decoded frames of every driver in the same process, see FrameHub
+  // -- at most max_rate times a second, scale and convert the tiles that changed, straight into one composite
+  // -- publish the composite as a single bgr8 image
+  //
+  // Run in the same container as the drivers. The video threads only swap references to the decoder's
+  // reference counted frames, all pixel work happens on this node's timer, once per changed tile. While
+  // nobody is subscribed the drivers don't hand out frames at all.
+
+  class MosaicNode : public rclcpp::Node
+  {
+  public:
+
+    explicit MosaicNode(const rclcpp::NodeOptions &options);
+
+    ~MosaicNode();
+
+  private:
+
+    struct Tile
+    {
+      int x;                                // Top left corner in the composite
+      int y;
+
+      std::mutex mtx;                       // Guards source, frame and dirty
+      std::string source;                   // Fully qualified driver name, "" if not yet assigned
+      AVFrame *frame;                       // Reference to the most recent frame, set by the video thread
+      bool dirty = false;                   // A frame arrived since the tile was last drawn
+
+      SwsContext *sws = nullptr;            // Used by the timer, cached across frames of the same size
+    };
+
+    // Called by the drivers' video threads, calls are serialized by the FrameHub
+    void on_frame(const std::string &source, const AVFrame &frame);
+
+    void timer_callback();
+
+    // Scale and convert one frame into its tile, YUV420P to BGR24 in one pass
+    bool draw(Tile &tile, const AVFrame &frame, const std::string &source);
+
+    int tile_width_;
+    int tile_height_;
+    int width_;                             // Composite dimensions
+    int height_;
+    bool assign_on_arrival_;                // No sources given, first come, first served
+
+    std::vector<std::unique_ptr<Tile>> tiles_;
+    std::vector<unsigned char> composite_;  // Preallocated BGR24, tiles are drawn in place
+    AVFrame *scratch_;                      // The timer moves a tile's frame here and draws outside the lock
+
+    int listener_id_;
+    bool wanted_ = false;                   // Told the FrameHub that we want frames
+    rclcpp::Publisher<sensor_msgs::msg::Image>::SharedPtr image_pub_;
+    rclcpp::TimerBase::SharedPtr timer_;
+  };
+
+} // namespace tello_mosaic
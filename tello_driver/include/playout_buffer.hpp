@@ -0,0 +1,102 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+struct AVFrame;
+
+namespace tello_driver
+{
+
+  //=====================================================================================
+  // Playout buffer, no ROS required
+  //
+  // Smooths bursty frame arrival. Decoded frames are held for a target delay and released
+  // one per frame interval on a dedicated thread, using absolute deadlines so the cadence
+  // doesn't drift. The frame interval is the mean inter-arrival time.
+  //
+  // If adaptive, the target delay follows the measured arrival jitter, between min_delay
+  // and max_delay. The release interval is stretched or shrunk by up to 10% to steer the
+  // actual delay toward the target, so the delay changes without visible jumps.
+  //
+  // Frames are held as AVFrame references to the decoder's reference counted buffers,
+  // buffering doesn't copy pixels. A frame without buffers of its own would be copied.
+  //=====================================================================================
+
+  struct PlayoutStats
+  {
+    int frames_in = 0;        // Frames pushed
+    int frames_out = 0;       // Frames released
+    int late = 0;             // Frames that arrived after their release slot had passed
+    int underruns = 0;        // Release slots that found the buffer empty
+    int dropped = 0;          // Frames dropped to stay under max_delay
+    double target_delay = 0;  // Target delay in seconds, at the time of the call
+    double interval = 0;      // Release interval in seconds, at the time of the call
+    int buffered = 0;         // Frames in the buffer, at the time of the call
+  };
+
+  class PlayoutBuffer
+  {
+  public:
+
+    using Clock = std::chrono::steady_clock;
+
+    // Called on the playout thread, frame is valid until the call returns
+    using Release = std::function<void(const AVFrame &frame, Clock::time_point arrival)>;
+
+    struct Config
+    {
+      double min_delay;       // Target delay in seconds, or the lower bound if adaptive
+      double max_delay;       // Drop the oldest frames if they have been held this long
+      bool adaptive;          // Raise the target delay to cover the measured jitter
+    };
+
+    PlayoutBuffer(const Config &config, Release release);
+
+    ~PlayoutBuffer();
+
+    // Take a reference to frame and hold it, called by the decoding thread
+    void push(const AVFrame &frame, Clock::time_point arrival);
+
+    // Return the statistics gathered since the last call, and reset the counters
+    PlayoutStats take_stats();
+
+  private:
+
+    struct Entry
+    {
+      AVFrame *frame;
+      Clock::time_point arrival;
+    };
+
+    void run();
+
+    void drop_front();
+
+    Config config_;
+    Release release_;
+
+    std::mutex mtx_;                  // Guards everything below except thread_
+    std::condition_variable cv_;
+    std::deque<Entry> entries_;
+    bool stopping_ = false;
+
+    // Arrival statistics, updated by push()
+    Clock::time_point last_arrival_{};
+    double interval_;                 // Mean inter-arrival time in seconds
+    double jitter_ = 0;               // Mean deviation from interval_ in seconds
+    double target_delay_;
+
+    // Release state
+    bool priming_ = true;             // Hold the oldest frame for the target delay before releasing
+    int owed_ = 0;                    // Empty slots not yet matched by a late frame
+
+    PlayoutStats stats_;
+    std::thread thread_;
+  };
+
+} // namespace tello_driver
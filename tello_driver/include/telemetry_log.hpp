@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace tello_driver
+{
+
+  //=====================================================================================
+  // Columnar telemetry log
+  //
+  // Samples are appended to a memory-mapped file in fixed-size chunks. Each chunk holds
+  // one array per column, so a reader can pull a whole column with one memcpy per chunk.
+  // Appending a sample is one store per column plus a count update.
+  //
+  // Layout, all integers are little endian:
+  //
+  //    File header, 4096 bytes:
+  //      0  uint32 magic           TELEMETRY_LOG_MAGIC
+  //      4  uint32 version         TELEMETRY_LOG_VERSION
+  //      8  uint32 num_columns
+  //     12  uint32 chunk_capacity  Samples per chunk
+  //     16  uint64 chunk_size      Bytes per chunk, a multiple of 4096
+  //     24  uint64 num_chunks      Chunks started, the last one may be partially filled
+  //     64  column descriptors, 32 bytes each:
+  //            0  char   name[24]
+  //           24  uint32 type      TelemetryLogWriter::Type
+  //           28  uint32 offset    Offset of the column array within a chunk
+  //
+  //    Chunk i at 4096 + i * chunk_size:
+  //      0  uint64 count           Samples in this chunk, updated after each sample
+  //     64  column arrays
+  //=====================================================================================
+
+  constexpr uint32_t TELEMETRY_LOG_MAGIC = 0x474c5454;  // "TTLG"
+  constexpr uint32_t TELEMETRY_LOG_VERSION = 1;
+
+  enum class TelemetryType : uint32_t
+  {
+    INT32 = 0,
+    INT64 = 1,
+    FLOAT32 = 2,
+    FLOAT64 = 3,
+  };
+
+  struct TelemetryColumn
+  {
+    std::string name;
+    TelemetryType type;
+  };
+
+  class TelemetryLogWriter
+  {
+  public:
+
+    // Create or truncate the log file, throws std::runtime_error on failure
+    TelemetryLogWriter(const std::string &path, const std::vector<TelemetryColumn> &columns,
+                       uint32_t chunk_capacity = 4096);
+
+    ~TelemetryLogWriter();
+
+    // Start a new sample, then call set() for each column, then end_sample()
+    // Throws std::runtime_error if a new chunk is needed and cannot be mapped, the writer is then unusable
+    void begin_sample();
+
+    void set(size_t column, int32_t value)
+    { at<int32_t>(column) = value; }
+
+    void set(size_t column, int64_t value)
+    { at<int64_t>(column) = value; }
+
+    void set(size_t column, float value)
+    { at<float>(column) = value; }
+
+    void set(size_t column, double value)
+    { at<double>(column) = value; }
+
+    void end_sample();
+
+  private:
+
+    template<typename T>
+    T &at(size_t column)
+    { return reinterpret_cast<T *>(chunk_ + offsets_[column])[row_]; }
+
+    void map_chunk(uint64_t index);
+
+    int fd_;
+    uint8_t *header_;                   // Mapped file header
+    uint8_t *chunk_ = nullptr;          // Mapped current chunk
+    uint64_t chunk_index_ = 0;
+    uint64_t chunk_size_;
+    uint32_t chunk_capacity_;
+    uint64_t row_ = 0;                  // Row within the current chunk
+    std::vector<uint32_t> offsets_;     // Column offsets within a chunk
+  };
+
+  class TelemetryLogReader
+  {
+  public:
+
+    // Map the log file, throws std::runtime_error on failure
+    explicit TelemetryLogReader(const std::string &path);
+
+    ~TelemetryLogReader();
+
+    const std::vector<TelemetryColumn> &columns() const
+    { return columns_; }
+
+    // Index of the named column, throws std::out_of_range if missing
+    size_t column_index(const std::string &name) const;
+
+    // Total samples across all chunks
+    uint64_t num_samples() const;
+
+    // Copy one column for the whole log, T must match the column type
+    template<typename T>
+    std::vector<T> column(const std::string &name) const
+    {
+      size_t index = column_index(name);
+      if (type_size(columns_[index].type) != sizeof(T)) {
+        throw std::invalid_argument("wrong type for column " + name);
+      }
+      std::vector<T> result(num_samples());
+      result.resize(copy_column(index, result.data(), result.size()));
+      return result;
+    }
+
+    // Copy one column for the whole log, converting to double, for tools that don't care about types
+    std::vector<double> column_as_double(size_t index) const;
+
+    static size_t type_size(TelemetryType type);
+
+  private:
+
+    // Returns the number of samples copied
+    uint64_t copy_column(size_t index, void *out, uint64_t max_samples) const;
+
+    size_t size_;
+    const uint8_t *base_;
+    uint64_t num_chunks_;
+    uint64_t chunk_size_;
+    std::vector<TelemetryColumn> columns_;
+    std::vector<uint32_t> offsets_;
+  };
+
+} // namespace tello_driver
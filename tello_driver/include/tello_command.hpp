@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+
+#include "tello_msgs/msg/tello_command.hpp"
+
+namespace tello_driver
+{
+
+  //=====================================================================================
+  // Typed commands
+  //
+  // The only place that knows how to turn a tello_msgs/TelloCommand into Tello SDK text.
+  // Arguments are range-checked here, so a bad command is rejected before it costs a
+  // round trip to the drone.
+  //=====================================================================================
+
+  // Check and encode a command, returns false and sets error if the command is invalid
+  bool encode_command(const tello_msgs::msg::TelloCommand &command, std::string &text, std::string &error);
+
+} // namespace tello_driver
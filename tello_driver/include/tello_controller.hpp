@@ -0,0 +1,40 @@
+#pragma once
+
+#include "rclcpp/rclcpp.hpp"
+#include "tello_msgs/msg/flight_data.hpp"
+
+namespace tello_driver
+{
+
+  //=====================================================================================
+  // Controller plugin interface
+  //
+  // Controllers are loaded into the driver with pluginlib, set the controller parameter
+  // to the class name. update() is called on the state socket thread as each state packet
+  // is parsed (10Hz), and the setpoint is sent as an rc command right away, without a
+  // round trip over DDS. update() must not block.
+  //=====================================================================================
+
+  // Joystick positions, -100 to 100, values out of range are clamped
+  struct RcSetpoint
+  {
+    int lr = 0;               // Left / right
+    int fb = 0;               // Forward / back
+    int ud = 0;               // Up / down
+    int yaw = 0;              // Yaw
+  };
+
+  class Controller
+  {
+  public:
+
+    virtual ~Controller() = default;
+
+    // Called once on the driver thread, declare parameters here
+    virtual void initialize(rclcpp::Node &node) = 0;
+
+    // Compute a setpoint from the most recent state, return false to send nothing
+    virtual bool update(const tello_msgs::msg::FlightData &state, RcSetpoint &setpoint) = 0;
+  };
+
+} // namespace tello_driver
@@ -0,0 +1,342 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <asio.hpp>
+
+#include "h264decoder.hpp"
+
+using asio::ip::udp;
+
+namespace tello_driver
+{
+
+  //=====================================================================================
+  // Tello core: the Tello SDK protocol, no ROS required
+  //
+  // Three sockets, each receiving on its own thread: commands and responses, state
+  // packets, and h264 video, which is reassembled and decoded here. Results are handed
+  // out through callbacks on the socket threads, stamped with steady_clock time.
+  //
+  // Callbacks are called without any core locks held, so they may call back into the
+  // core, e.g., send a command from the state callback.
+  //=====================================================================================
+
+  using CoreClock = std::chrono::steady_clock;
+
+  enum class LogLevel
+  {
+    debug,
+    info,
+    warn,
+    error,
+  };
+
+  enum class CommandResult
+  {
+    ok,                       // Response was anything except 'error'
+    error,                    // Response was 'error'
+    timeout,                  // No response
+  };
+
+  enum class SdkVersion
+  {
+    unknown,
+    v1_3,
+    v2_0,
+  };
+
+  // Where to bind, so that several drones at 192.168.10.1 can be reached over several adapters
+  struct SocketBinding
+  {
+    std::string interface;                // Bind to this network interface (SO_BINDTODEVICE), "" for all
+    std::string address;                  // Bind to this local address, "" for any
+  };
+
+  struct CoreConfig
+  {
+    std::string drone_ip;                 // Send commands to this IP address
+    unsigned short drone_port;            // Send commands to this port
+    unsigned short command_port;          // Send commands from this port
+    unsigned short data_port;             // State packets arrive on this port
+    unsigned short video_port;            // Video packets arrive on this port
+    SocketBinding binding;
+  };
+
+  // A compressed frame, as parsed from the stream
+  struct AccessUnit
+  {
+    const unsigned char *data;            // Annex B, keyframes start with SPS and PPS
+    size_t size;
+    bool keyframe;
+    int width;                            // Stream dimensions from the most recent SPS
+    int height;
+  };
+
+  struct CoreCallbacks
+  {
+    std::function<void(LogLevel level, const std::string &msg)> log;
+
+    // Optional, return false to skip building messages at this level, e.g., debug messages on hot paths
+    std::function<bool(LogLevel level)> log_enabled;
+
+    // A state packet arrived, parse it with TelloCore::parse_fields() if needed
+    std::function<void(const std::string &raw, CoreClock::time_point time)> state;
+
+    // A command completed, respond is the flag passed to initiate_command()
+    std::function<void(const std::string &command, CommandResult result, const std::string &str,
+                       bool respond)> response;
+
+    // A frame was decoded, frame is valid until the callback returns
+    std::function<void(const AVFrame &frame, CoreClock::time_point time)> frame;
+
+    // A frame was parsed, called before it's decoded, or skipped, au is valid until the callback returns
+    std::function<void(const AccessUnit &au, CoreClock::time_point time)> access_unit;
+  };
+
+  //=====================================================================================
+  // Video statistics, counted by the video socket thread
+  //=====================================================================================
+
+  struct VideoStats
+  {
+    int packets = 0;          // UDP packets received
+    int sequences = 0;        // Packet sequences, each sequence holds one or more h264 frames
+    int dropped = 0;          // Sequences dropped due to buffer overflow
+    int errors = 0;           // Sequences with decode errors
+    int frames = 0;           // Frames decoded
+    int skipped = 0;          // Frames skipped without decoding
+  };
+
+  class TelloCore;
+
+  //=====================================================================================
+  // Abstract socket
+  //=====================================================================================
+
+  class TelloSocket
+  {
+  public:
+
+    TelloSocket(TelloCore *core, const SocketBinding &binding, unsigned short port);
+
+    virtual ~TelloSocket();
+
+    // Stop the receive thread, call before the derived class is destroyed
+    void stop();
+
+    bool receiving();
+
+    CoreClock::time_point receive_time();
+
+    // Packets received so far
+    uint64_t packets();
+
+    virtual void timeout();
+
+  protected:
+
+    void listen();
+
+    // Note a packet, returns true if it's the first since the last timeout, mtx_ must be held
+    bool note_packet();
+
+    virtual void process_packet(size_t r) = 0;
+
+    TelloCore *core_;                     // Pointer to the core, for callbacks
+    asio::io_service io_service_;         // Manages IO for this socket
+    udp::socket socket_;                  // The socket
+    std::thread thread_;                  // Each socket receives on it's own thread
+    std::atomic<bool> stopping_{false};
+    std::mutex mtx_;                      // All public calls must be guarded
+    bool receiving_ = false;              // Are we receiving packets on this socket?
+    CoreClock::time_point receive_time_;  // Time of most recent receive
+    uint64_t packets_ = 0;
+    std::vector<unsigned char> buffer_;   // Packet buffer
+  };
+
+  //=====================================================================================
+  // Command socket
+  //=====================================================================================
+
+  class CommandSocket : public TelloSocket
+  {
+  public:
+
+    CommandSocket(TelloCore *core, const SocketBinding &binding, const std::string &drone_ip,
+                  unsigned short drone_port, unsigned short command_port);
+
+    void timeout() override;
+
+    bool waiting();
+
+    // Commands sent so far
+    uint64_t sent();
+
+    // Returns false if the socket is waiting for a response to another command
+    bool initiate_command(const std::string &command, bool respond);
+
+  private:
+
+    void process_packet(size_t r) override;
+
+    udp::endpoint remote_endpoint_;
+
+    std::string command_;     // Most recent command
+    uint64_t sent_ = 0;       // Commands sent
+    bool respond_ = false;    // Passed back in the response callback
+    bool waiting_ = false;    // Are we waiting for a response?
+  };
+
+  //=====================================================================================
+  // State socket
+  //=====================================================================================
+
+  class StateSocket : public TelloSocket
+  {
+  public:
+
+    StateSocket(TelloCore *core, const SocketBinding &binding, unsigned short data_port);
+
+    // Look up a field in the most recent state packet
+    bool field(const std::string &key, std::string &value, CoreClock::time_point &time);
+
+    SdkVersion sdk();
+
+  private:
+
+    void process_packet(size_t r) override;
+
+    std::string raw_;                     // Most recent state packet
+    SdkVersion sdk_ = SdkVersion::unknown;
+  };
+
+  //=====================================================================================
+  // Video socket
+  //=====================================================================================
+
+  class VideoSocket : public TelloSocket
+  {
+  public:
+
+    VideoSocket(TelloCore *core, const SocketBinding &binding, unsigned short video_port);
+
+    // Return the statistics gathered since the last call, and reset
+    VideoStats take_stats();
+
+    // Skip everything except keyframes, applied at the next sequence
+    void set_keyframes_only(bool keyframes_only);
+
+  private:
+
+    void process_packet(size_t r) override;
+
+    void decode_frames();
+
+    void resize_stream(int width, int height);
+
+    std::vector<unsigned char> seq_buffer_;   // Collect video packets into a larger sequence
+    size_t seq_buffer_next_ = 0;              // Next available spot in the sequence buffer
+    size_t seq_buffer_wanted_ = 0;            // Grow the sequence buffer to this size at the next sequence
+    int seq_buffer_num_packets_ = 0;          // How many packets we've collected, for debugging
+    size_t packet_size_;                      // Largest packet seen, shorter packets end a sequence
+    size_t run_size_ = 0;                     // Size of the most recent packets
+    int run_length_ = 0;                      // How many packets in a row had run_size_
+
+    int stream_width_ = 0;                    // Stream dimensions from the SPS
+    int stream_height_ = 0;
+    VideoStats stats_;                        // Statistics since the last call to take_stats()
+
+    std::atomic<bool> next_keyframes_only_{false};  // Set by any thread
+    bool keyframes_only_ = false;             // Used by the video thread
+    H264Decoder decoder_;                     // Decodes h264
+  };
+
+  //=====================================================================================
+  // Tello core
+  //=====================================================================================
+
+  class TelloCore
+  {
+  public:
+
+    TelloCore(const CoreConfig &config, CoreCallbacks callbacks);
+
+    ~TelloCore();
+
+    // Split a state packet on ";" and ":"
+    static std::map<std::string, std::string> parse_fields(const std::string &raw);
+
+    // Returns false if the drone hasn't responded to the previous command
+    bool initiate_command(const std::string &command, bool respond)
+    { return command_socket_->initiate_command(command, respond); }
+
+    bool command_waiting()
+    { return command_socket_->waiting(); }
+
+    // Give up on the current command, the response callback gets a timeout
+    void command_timeout()
+    { command_socket_->timeout(); }
+
+    bool state_receiving()
+    { return state_socket_->receiving(); }
+
+    void state_timeout()
+    { state_socket_->timeout(); }
+
+    bool video_receiving()
+    { return video_socket_->receiving(); }
+
+    void video_timeout()
+    { video_socket_->timeout(); }
+
+    // Activity counters, for callers that keep time with another clock
+    uint64_t commands_sent()
+    { return command_socket_->sent(); }
+
+    uint64_t state_packets()
+    { return state_socket_->packets(); }
+
+    uint64_t video_packets()
+    { return video_socket_->packets(); }
+
+    // Look up a field in the most recent state packet
+    bool state_field(const std::string &key, std::string &value, CoreClock::time_point &time)
+    { return state_socket_->field(key, value, time); }
+
+    SdkVersion sdk()
+    { return state_socket_->sdk(); }
+
+    VideoStats take_video_stats()
+    { return video_socket_->take_stats(); }
+
+    void set_keyframes_only(bool keyframes_only)
+    { video_socket_->set_keyframes_only(keyframes_only); }
+
+    // Used by the sockets
+    void log(LogLevel level, const std::string &msg) const;
+
+    // Check before building an expensive message
+    bool log_enabled(LogLevel level) const;
+
+    const CoreCallbacks &callbacks() const
+    { return callbacks_; }
+
+  private:
+
+    CoreCallbacks callbacks_;
+
+    std::unique_ptr<CommandSocket> command_socket_;
+    std::unique_ptr<StateSocket> state_socket_;
+    std::unique_ptr<VideoSocket> video_socket_;
+  };
+
+} // namespace tello_driver
@@ -1,30 +1,272 @@
-#include <asio.hpp>
-
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <thread>
+
+#include "pluginlib/class_loader.hpp"
 #include "rclcpp/rclcpp.hpp"
 #include "cv_bridge/cv_bridge.h"
 #include "geometry_msgs/msg/twist.hpp"
 #include "sensor_msgs/msg/camera_info.hpp"
 #include "tello_msgs/msg/flight_data.hpp"
+#include "tello_msgs/msg/mission_status.hpp"
+#include "tello_msgs/msg/playout_stats.hpp"
+#include "tello_msgs/msg/schedule_report.hpp"
 #include "tello_msgs/msg/tello_response.hpp"
 #include "tello_msgs/srv/tello_action.hpp"
-
-#include "h264decoder.hpp"
-
-using asio::ip::udp;
+#include "tello_msgs/srv/tello_black_box.hpp"
+#include "tello_msgs/srv/tello_capture_still.hpp"
+#include "tello_msgs/srv/tello_mission.hpp"
+#include "tello_msgs/srv/tello_query.hpp"
+#include "tello_msgs/srv/tello_schedule.hpp"
+#include "tello_msgs/srv/tello_typed_action.hpp"
+
+#include "black_box.hpp"
+#include "command_scheduler.hpp"
+#include "frame_ring.hpp"
+#include "playout_buffer.hpp"
+#include "telemetry_log.hpp"
+#include "tello_command.hpp"
+#include "tello_controller.hpp"
+#include "tello_core.hpp"
 
 namespace tello_driver
 {
 
-  class CommandSocket;
+  struct TelloDriverContext;
+
+  struct PipelineConfig;
+
+  class TelloDriverNode;
+
+  class FlightDataPublisher;
+
+  class VideoPublisher;
+
+  //=====================================================================================
+  // Bitrate controller
+  //
+  // Steps video bitrate and resolution down when the link degrades, and back up when it
+  // recovers. Uses hysteresis to avoid oscillation: stepping down requires a few bad
+  // evaluations in a row, stepping up requires many good evaluations in a row.
+  //
+  // Requires SDK 2.0+ (setbitrate, setresolution).
+  //=====================================================================================
+
+  class BitrateController
+  {
+  public:
+
+    struct Config
+    {
+      double error_high;      // Step down if the sequence error rate is above this
+      double error_low;       // Step up only if the sequence error rate is below this
+      int snr_low;            // Step down if the wifi SNR is below this
+      int snr_high;           // Step up only if the wifi SNR is above this
+      int down_count;         // Step down after this many bad evaluations
+      int up_count;           // Step up after this many good evaluations
+    };
+
+    explicit BitrateController(const Config &config);
+
+    // Evaluate the most recent interval, snr < 0 means unknown
+    // Returns true if the level changed, and fills commands with the commands to send
+    bool update(const VideoStats &stats, int snr, std::vector<std::string> &commands);
+
+    int level() const
+    { return level_; }
+
+  private:
+
+    Config config_;
+    int level_;               // Index into the bitrate ladder
+    int bad_ = 0;             // Consecutive bad evaluations
+    int good_ = 0;            // Consecutive good evaluations
+  };
+
+  //=====================================================================================
+  // Query cache
+  //
+  // Remembers the most recent answer to each '?' command, e.g., 'wifi?' or 'sdk?'.
+  // Answers are stored by the command socket thread and read by the ROS thread.
+  //=====================================================================================
+
+  class QueryCache
+  {
+  public:
+
+    struct Entry
+    {
+      std::string value;                  // Most recent answer, empty if none
+      rclcpp::Time answer_time;           // Time of most recent answer
+      rclcpp::Time request_time;          // Time of most recent request from a ROS client
+      bool stale = false;                 // A ROS client found the answer too old, refresh before the TTL
+    };
+
+    static bool is_query(const std::string &command);
+
+    // Store an answer from the drone
+    void store(const std::string &query, const std::string &value, const rclcpp::Time &now);
+
+    // Note a request from a ROS client, returns true and fills entry if there is an answer
+    bool request(const std::string &query, const rclcpp::Time &now, Entry &entry);
+
+    // A ROS client found the answer too old, refresh it next
+    void mark_stale(const std::string &query);
+
+    // Find the stalest query that a ROS client has asked for recently
+    bool next_refresh(const rclcpp::Time &now, const rclcpp::Duration &ttl, std::string &query);
+
+  private:
+
+    std::mutex mtx_;
+    std::map<std::string, Entry> entries_;
+  };
+
+  //=====================================================================================
+  // Publish governor
+  //
+  // Limits the publish rate of a topic, so that callers can skip message work entirely.
+  // Keeps the long-run average at max_rate even if the source rate isn't a multiple of it.
+  // Each governor is used by a single socket thread, the rate may be set from any thread.
+  //=====================================================================================
+
+  class PublishGovernor
+  {
+  public:
+
+    // Max publish rate in Hz, 0 for no limit
+    void set_max_rate(double max_rate)
+    {
+      interval_ns_.store(max_rate > 0 ? static_cast<int64_t>(1e9 / max_rate) : 0);
+    }
+
+    // Returns true if a message may be published now
+    bool ready(const rclcpp::Time &now)
+    {
+      int64_t interval_ns = interval_ns_.load();
+      if (interval_ns == 0) {
+        return true;
+      }
+
+      int64_t now_ns = now.nanoseconds();
+      if (now_ns < next_ns_) {
+        return false;
+      }
+
+      // Don't allow a burst after a long gap
+      next_ns_ = now_ns - next_ns_ > interval_ns ? now_ns + interval_ns : next_ns_ + interval_ns;
+      return true;
+    }
+
+  private:
+
+    std::atomic<int64_t> interval_ns_{0};
+    int64_t next_ns_ = 0;
+  };
+
+  //=====================================================================================
+  // Mission executor
+  //
+  // Runs an uploaded mission on the socket threads: the next command is sent as soon as
+  // the drone responds to the previous one, and conditions are checked as each state
+  // packet arrives. Waits are checked on each state packet and on the driver timer.
+  //
+  // Lock order is state socket -> mission -> command socket. The command socket calls
+  // on_response() after releasing its own lock.
+  //=====================================================================================
+
+  class MissionExecutor
+  {
+  public:
+
+    using Fields = std::map<std::string, std::string>;
+
+    // send() sends a command and returns false if the command socket is busy
+    MissionExecutor(TelloDriverNode *driver, std::function<bool(const std::string &)> send);
+
+    // Start a mission, returns false and sets error if the mission is invalid
+    bool start(const std::vector<tello_msgs::msg::MissionStep> &steps, const rclcpp::Time &now, std::string &error);
+
+    void cancel(const rclcpp::Time &now);
+
+    bool running() const { return running_; }
+
+    // A command completed, called by the command socket thread
+    void on_response(uint8_t rc, const std::string &str, const rclcpp::Time &now);
+
+    // A state packet arrived, called by the state socket thread
+    void on_telemetry(const Fields &fields, const rclcpp::Time &now);
+
+    // Called by the driver timer, retries sends and ends timed waits
+    void on_tick(const rclcpp::Time &now);
 
-  class StateSocket;
+    // State packets stopped, fail the running mission
+    void on_telemetry_lost(const rclcpp::Time &now);
 
-  class VideoSocket;
+  private:
+
+    enum class Phase
+    {
+      ready,                  // Start the next step
+      sending,                // Send text_, retry if the command socket is busy
+      waiting_response,       // Wait for the drone to respond to text_
+      waiting_time,           // Wait until deadline_
+      waiting_condition,      // Wait until condition_ is true, or fail at deadline_
+    };
+
+    struct Condition
+    {
+      std::string field;
+      uint8_t op;
+      double value;
+
+      // Returns true if the field is present and the condition holds
+      bool eval(const Fields &fields) const;
+    };
+
+    struct Step
+    {
+      uint8_t type;
+      std::string text;       // Encoded command for COMMAND and WATCH
+      Condition condition;    // WAIT_UNTIL and WATCH
+      double timeout;
+    };
+
+    struct Watch
+    {
+      Condition condition;
+      std::string text;
+    };
+
+    void advance(const rclcpp::Time &now, const Fields *fields);
+
+    void finish(uint8_t state, const rclcpp::Time &now, const std::string &str);
+
+    void publish_status(uint8_t state, const rclcpp::Time &now, const std::string &str);
+
+    TelloDriverNode *driver_;
+    std::function<bool(const std::string &)> send_;
+
+    std::mutex mtx_;
+    std::atomic<bool> running_{false};
+    std::vector<Step> steps_;
+    size_t next_ = 0;                   // Next step to start
+    Phase phase_ = Phase::ready;
+    std::string text_;                  // Command being sent
+    rclcpp::Time deadline_;
+    Condition condition_;
+    std::vector<Watch> watches_;
+    bool aborting_ = false;             // A watch fired, finish with ABORTED
+  };
 
   //=====================================================================================
   // Tello driver implements Tello SDK 1.3 and 2.0
   //
-  // Socket threads make these calls, which AFAIK are reentrant:
+  // A thin ROS adapter on top of TelloCore. Core callbacks arrive on the socket threads
+  // and make these calls, which AFAIK are reentrant:
   // rclcpp::Node::now()
   // rclcpp::Node::count_subscribers()
   // rclcpp::Node::get_logger()
@@ -47,12 +289,65 @@ namespace tello_driver
 
     // ROS publishers
     rclcpp::Publisher<sensor_msgs::msg::Image>::SharedPtr image_pub_;
+    rclcpp::Publisher<sensor_msgs::msg::Image>::SharedPtr image_gray_pub_;
     rclcpp::Publisher<sensor_msgs::msg::CameraInfo>::SharedPtr camera_info_pub_;
     rclcpp::Publisher<tello_msgs::msg::FlightData>::SharedPtr flight_data_pub_;
     rclcpp::Publisher<tello_msgs::msg::TelloResponse>::SharedPtr tello_response_pub_;
+    rclcpp::Publisher<tello_msgs::msg::MissionStatus>::SharedPtr mission_status_pub_;
+    rclcpp::Publisher<tello_msgs::msg::PlayoutStats>::SharedPtr playout_stats_pub_;
+    rclcpp::Publisher<tello_msgs::msg::ScheduleReport>::SharedPtr schedule_report_pub_;
+
+    // Publish rate limits, checked before any message work
+    PublishGovernor image_governor_;
+    PublishGovernor image_gray_governor_;
+    PublishGovernor camera_info_governor_;
+    PublishGovernor flight_data_governor_;
+
+    // Answers to '?' commands
+    QueryCache query_cache_;
+
+    // Runs uploaded missions, created before the core
+    std::unique_ptr<MissionExecutor> mission_executor_;
+
+    // Controller plugin, nullptr if none, called by the state socket thread
+    // The state thread unloads a failed controller, other threads use std::atomic_load
+    std::shared_ptr<Controller> controller_;
+
+    // Recent video and telemetry, nullptr if disabled, fed by the core threads
+    std::unique_ptr<BlackBox> black_box_;
+
+    // The Tello protocol, created last and destroyed first
+    std::unique_ptr<TelloCore> core_;
+
+    // Send a setpoint as an rc command, returns false if the command socket is busy
+    bool send_setpoint(const RcSetpoint &setpoint);
 
   private:
 
+    // Core callbacks
+    void on_log(LogLevel level, const std::string &msg);
+
+    void on_response(const std::string &command, CommandResult result, const std::string &str, bool respond);
+
+    // Note activity from the core counters in ROS time, so that timeouts follow use_sim_time
+    void note_activity();
+
+    // Loads controller_, must outlive it
+    std::unique_ptr<pluginlib::ClassLoader<Controller>> controller_loader_;
+
+    // Declare <topic>.reliability, .depth, .durability and .max_rate parameters, return the QoS
+    rclcpp::QoS topic_qos(const std::string &topic, const rclcpp::QoS &default_qos,
+                          PublishGovernor *governor = nullptr);
+
+    // Build a pipeline configuration from the parameters
+    PipelineConfig pipeline_config();
+
+    // Parameters changed, hand the video socket a new pipeline configuration
+    void apply_pipeline();
+
+    // Apply <topic>.max_rate changes, reject changes to parameters that are read at startup
+    rcl_interfaces::msg::SetParametersResult rate_callback(const std::vector<rclcpp::Parameter> &parameters);
+
     void timer_callback();
 
     void command_callback(
@@ -60,130 +355,228 @@ namespace tello_driver
       const std::shared_ptr<tello_msgs::srv::TelloAction::Request> request,
       std::shared_ptr<tello_msgs::srv::TelloAction::Response> response);
 
+    void typed_command_callback(
+      const std::shared_ptr<rmw_request_id_t> request_header,
+      const std::shared_ptr<tello_msgs::srv::TelloTypedAction::Request> request,
+      std::shared_ptr<tello_msgs::srv::TelloTypedAction::Response> response);
+
+    void mission_callback(
+      const std::shared_ptr<rmw_request_id_t> request_header,
+      const std::shared_ptr<tello_msgs::srv::TelloMission::Request> request,
+      std::shared_ptr<tello_msgs::srv::TelloMission::Response> response);
+
+    void query_callback(
+      const std::shared_ptr<rmw_request_id_t> request_header,
+      const std::shared_ptr<tello_msgs::srv::TelloQuery::Request> request,
+      std::shared_ptr<tello_msgs::srv::TelloQuery::Response> response);
+
+    void schedule_callback(
+      const std::shared_ptr<rmw_request_id_t> request_header,
+      const std::shared_ptr<tello_msgs::srv::TelloSchedule::Request> request,
+      std::shared_ptr<tello_msgs::srv::TelloSchedule::Response> response);
+
+    // Deferred response, a still may wait for the next keyframe
+    void capture_still_callback(
+      const std::shared_ptr<rmw_request_id_t> request_header,
+      const std::shared_ptr<tello_msgs::srv::TelloCaptureStill::Request> request);
+
+    void black_box_callback(
+      const std::shared_ptr<rmw_request_id_t> request_header,
+      const std::shared_ptr<tello_msgs::srv::TelloBlackBox::Request> request,
+      std::shared_ptr<tello_msgs::srv::TelloBlackBox::Response> response);
+
     void cmd_vel_callback(const geometry_msgs::msg::Twist::SharedPtr msg);
 
-    // Sockets
-    std::unique_ptr<CommandSocket> command_socket_;
-    std::unique_ptr<StateSocket> state_socket_;
-    std::unique_ptr<VideoSocket> video_socket_;
+    // Adapt core state and frames to ROS
+    std::unique_ptr<FlightDataPublisher> flight_data_publisher_;
+    std::unique_ptr<VideoPublisher> video_publisher_;
+
+    // Core activity in ROS time, noted once a second by the timer
+    uint64_t commands_sent_ = 0;
+    uint64_t state_packets_ = 0;
+    uint64_t video_packets_ = 0;
+    rclcpp::Time command_time_;
+    rclcpp::Time state_time_;
+    rclcpp::Time video_time_;
 
     // ROS services
     rclcpp::Service<tello_msgs::srv::TelloAction>::SharedPtr command_srv_;
+    rclcpp::Service<tello_msgs::srv::TelloTypedAction>::SharedPtr typed_command_srv_;
+    rclcpp::Service<tello_msgs::srv::TelloMission>::SharedPtr mission_srv_;
+    rclcpp::Service<tello_msgs::srv::TelloQuery>::SharedPtr query_srv_;
+    rclcpp::Service<tello_msgs::srv::TelloSchedule>::SharedPtr schedule_srv_;
+    rclcpp::Service<tello_msgs::srv::TelloBlackBox>::SharedPtr black_box_srv_;
+    rclcpp::Service<tello_msgs::srv::TelloCaptureStill>::SharedPtr capture_still_srv_;
 
     // ROS subscriptions
     rclcpp::Subscription<geometry_msgs::msg::Twist>::SharedPtr cmd_vel_sub_;
 
     // ROS timer
     rclcpp::TimerBase::SharedPtr spin_timer_;
+
+    // Parameters, some can be changed while the node is running
+    std::unique_ptr<TelloDriverContext> cxt_;
+    std::map<std::string, PublishGovernor *> governors_;   // Keyed by <topic>.max_rate
+    rclcpp::node_interfaces::OnSetParametersCallbackHandle::SharedPtr rate_callback_handle_;
+
+    // Warn once if scheduled commands won't run at a real-time priority
+    bool schedule_warned_ = false;
+
+    // Query parameters
+    double query_ttl_;        // Refresh cached answers older than this, in seconds
+    double query_idle_;       // Only refresh if the command channel has been idle this long, in seconds
+
+    // Adapt video bitrate to the link, nullptr if disabled
+    std::unique_ptr<BitrateController> bitrate_controller_;
+    std::deque<std::string> bitrate_commands_;  // Commands waiting for an idle command channel
+
+    // Video settings, sent after "command" and before "streamon"
+    std::vector<std::string> video_commands_;
+    std::deque<std::string> connect_commands_;  // Video settings not yet sent on this connection
   };
 
   //=====================================================================================
-  // Abstract socket
+  // Flight data publisher, adapts core state packets to ROS
+  //
+  // Runs on the core state thread. Only parses the packet, and only asks for ROS time,
+  // if something needs the result.
   //=====================================================================================
 
-  class TelloSocket
+  class FlightDataPublisher
   {
   public:
 
-    TelloSocket(TelloDriverNode *driver, unsigned short port) :
-      driver_(driver), socket_(io_service_, udp::endpoint(udp::v4(), port))
-    {}
-
-    bool receiving();
-
-    rclcpp::Time receive_time();
+    FlightDataPublisher(TelloDriverNode *driver, const std::string &telemetry_log_path);
 
-    virtual void timeout();
+    void on_state(const std::string &raw, CoreClock::time_point time);
 
-  protected:
-
-    void listen();
+  private:
 
-    virtual void process_packet(size_t r) = 0;
+    void log_sample(const tello_msgs::msg::FlightData &msg);
 
-    TelloDriverNode *driver_;             // Pointer to the driver node
-    asio::io_service io_service_;         // Manages IO for this socket
-    udp::socket socket_;                  // The socket
-    std::thread thread_;                  // Each socket receives on it's own thread
-    std::mutex mtx_;                      // All public calls must be guarded
-    bool receiving_ = false;              // Are we receiving packets on this socket?
-    rclcpp::Time receive_time_;           // Time of most recent receive
-    std::vector<unsigned char> buffer_;   // Packet buffer
+    TelloDriverNode *driver_;
+    std::unique_ptr<TelemetryLogWriter> telemetry_log_;       // Columnar telemetry log, nullptr if disabled
   };
 
   //=====================================================================================
-  // Command socket
+  // Video publisher, adapts decoded core frames to ROS
+  //
+  // Runs on the core video thread: converts pixels and publishes images, camera info and
+  // the shared memory ring. If playout is enabled frames are handed to a playout buffer
+  // instead, and published from the playout thread at an even rate.
+  //
+  // Also keeps a reference to the most recent decoded frame, so stills can be converted
+  // on demand without anyone subscribing to the stream.
   //=====================================================================================
 
-  class CommandSocket : public TelloSocket
+  struct VideoConfig
   {
-  public:
-
-    CommandSocket(TelloDriverNode *driver, std::string drone_ip, unsigned short drone_port,
-                  unsigned short command_port);
-
-    void timeout() override;
-
-    bool waiting();
+    std::string camera_info_path;             // Camera calibration path
+    std::string shm_ring_name;                // Write frames to this shared memory ring, "" to disable
+    int shm_ring_slots;                       // Number of frames in the ring
+    PlayoutBuffer::Config playout;            // Smooth frame timing, min_delay <= 0 to disable
+  };
 
-    rclcpp::Time send_time();
+  // Can change while the node is running, applied between frames
+  struct PipelineConfig
+  {
+    bool keyframes_only;                      // Skip everything except keyframes
+    int convert_stripes;                      // Convert pixels using this many threads
+    std::string encoding;                     // bgr8 or rgb8
+
+    bool operator==(const PipelineConfig &other) const
+    {
+      return keyframes_only == other.keyframes_only && convert_stripes == other.convert_stripes &&
+             encoding == other.encoding;
+    }
+  };
 
-    void initiate_command(std::string command, bool respond);
+  class VideoPublisher
+  {
+  public:
 
-  private:
+    VideoPublisher(TelloDriverNode *driver, const VideoConfig &config, const PipelineConfig &pipeline);
 
-    void process_packet(size_t r) override;
+    ~VideoPublisher();
 
-    void complete_command(uint8_t rc, std::string str);
+    // Use a new pipeline configuration from the next frame on, doesn't block the video thread
+    void set_pipeline(const PipelineConfig &pipeline);
 
-    udp::endpoint remote_endpoint_;
+    void on_frame(const AVFrame &frame, CoreClock::time_point time);
 
-    rclcpp::Time send_time_;  // Time of most recent send
-    bool respond_;            // Send response on tello_response_pub_
-    bool waiting_ = false;    // Are we waiting for a response?
-  };
+    // Returns false if playout is disabled
+    bool take_playout_stats(PlayoutStats &stats);
 
-  //=====================================================================================
-  // State socket
-  //=====================================================================================
+    using StillRequest = std::shared_ptr<tello_msgs::srv::TelloCaptureStill::Request>;
+    using StillResponse = std::shared_ptr<tello_msgs::srv::TelloCaptureStill::Response>;
+    using StillRespond = std::function<void(StillResponse response)>;
 
-  class StateSocket : public TelloSocket
-  {
-  public:
+    // Convert a still, respond() is called on this thread, or on the still thread if waiting for a keyframe
+    void capture_still(StillRequest request, StillRespond respond);
 
-    StateSocket(TelloDriverNode *driver, unsigned short data_port);
+    // Respond to stills that have waited too long for a keyframe, called by the driver timer
+    void expire_stills();
 
   private:
 
-    void process_packet(size_t r) override;
+    struct StillWaiter
+    {
+      StillRequest request;
+      StillRespond respond;
+      CoreClock::time_point deadline;
+    };
 
-    uint8_t sdk_ = tello_msgs::msg::FlightData::SDK_UNKNOWN;  // Tello SDK version
-  };
+    struct StillJob
+    {
+      StillRequest request;
+      StillRespond respond;
+      AVFrame *frame;                         // A reference to the keyframe, freed by the still thread
+      CoreClock::time_point time;
+    };
 
-  //=====================================================================================
-  // Video socket
-  //=====================================================================================
+    // Converts keyframes for waiters, so the video thread never encodes
+    void run_stills();
 
-  class VideoSocket : public TelloSocket
-  {
-  public:
+    void convert_still(const StillRequest &request, const AVFrame &frame, CoreClock::time_point time,
+                       const StillRespond &respond);
 
-    VideoSocket(TelloDriverNode *driver, unsigned short video_port, const std::string &camera_info_path);
+    void publish_frame(const AVFrame &frame);
 
-  private:
+    void apply_pipeline();
 
-    void process_packet(size_t r) override;
+    void resize_stream(int width, int height);
 
-    void decode_frames();
+    TelloDriverNode *driver_;
+    std::string source_;                      // Fully qualified node name, identifies frames in the FrameHub
 
-    std::vector<unsigned char> seq_buffer_;   // Collect video packets into a larger sequence
-    size_t seq_buffer_next_ = 0;              // Next available spot in the sequence buffer
-    int seq_buffer_num_packets_ = 0;          // How many packets we've collected, for debugging
+    int stream_width_ = 0;                    // Frame dimensions
+    int stream_height_ = 0;
+    std::vector<unsigned char> bgr_buffer_;   // Converted pixels, sized for the current stream
 
-    H264Decoder decoder_;                     // Decodes h264
+    std::shared_ptr<const PipelineConfig> next_pipeline_;   // Set by any thread, taken between frames
+    PipelineConfig pipeline_{};               // Configuration used by the video thread
     ConverterRGB24 converter_;                // Converts pixels from YUV420P to BGR24
 
+    std::string shm_ring_name_;               // Shared memory ring name, "" if disabled
+    int shm_ring_slots_;
+    std::unique_ptr<FrameRingWriter> frame_ring_;
+
     sensor_msgs::msg::CameraInfo camera_info_msg_;
+
+    std::mutex still_mtx_;                    // Guards latest_, still_waiters_, still_jobs_ and still_stopping_
+    AVFrame *latest_;                         // Reference to the most recent decoded frame
+    CoreClock::time_point latest_time_;
+    std::vector<StillWaiter> still_waiters_;  // Waiting for the next keyframe
+    std::deque<StillJob> still_jobs_;         // Keyframes to convert on the still thread
+    bool still_stopping_ = false;
+    std::condition_variable still_cv_;
+    std::thread still_thread_;
+
+    std::mutex still_convert_mtx_;            // Guards still_converter_ and still_buffer_
+    ConverterRGB24 still_converter_;          // Stills are converted on the caller's thread
+    std::vector<unsigned char> still_buffer_;
+
+    std::unique_ptr<PlayoutBuffer> playout_;  // nullptr if disabled, stopped first
   };
 
 } // namespace tello_driver
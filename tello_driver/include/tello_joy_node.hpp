@@ -1,7 +1,7 @@
 #include "rclcpp/rclcpp.hpp"
 #include "geometry_msgs/msg/twist.hpp"
 #include "sensor_msgs/msg/joy.hpp"
-#include "tello_msgs/srv/tello_action.hpp"
+#include "tello_msgs/srv/tello_typed_action.hpp"
 
 namespace tello_joy
 {
@@ -32,7 +32,7 @@ namespace tello_joy
 
     rclcpp::Subscription<sensor_msgs::msg::Joy>::SharedPtr joy_sub_;
     rclcpp::Publisher<geometry_msgs::msg::Twist>::SharedPtr cmd_vel_pub_;
-    rclcpp::Client<tello_msgs::srv::TelloAction>::SharedPtr tello_client_;
+    rclcpp::Client<tello_msgs::srv::TelloTypedAction>::SharedPtr tello_client_;
 
     // XBox One assignments
     const int joy_axis_throttle_ = JOY_AXIS_RIGHT_FB;
@@ -1,17 +1,25 @@
 from launch import LaunchDescription
+from launch.actions import DeclareLaunchArgument, ExecuteProcess
+from launch.conditions import IfCondition
+from launch.substitutions import LaunchConfiguration, PythonExpression
 from launch_ros.actions import Node
-from launch.actions import ExecuteProcess
 
 
 # Launch an emulator for testing
+# Pass time_scale:=N to run N times faster than real time, the driver will use sim time
 
 
 def generate_launch_description():
     emulator_path = 'install/tello_driver/lib/tello_driver/tello_emulator'
-    tello_driver_params = [{'drone_ip': '127.0.0.1'}]
+    time_scale = LaunchConfiguration('time_scale')
+    use_sim_time = PythonExpression([time_scale, ' != 1.0'])
+    tello_driver_params = [{'drone_ip': '127.0.0.1', 'use_sim_time': use_sim_time}]
 
     return LaunchDescription([
-        ExecuteProcess(cmd=[emulator_path], output='screen'),
+        DeclareLaunchArgument('time_scale', default_value='1.0'),
+        ExecuteProcess(cmd=[emulator_path, 'Emulator', '8889', '8890', '11111', time_scale], output='screen'),
+        Node(package='tello_driver', executable='tello_sim_clock', output='screen',
+             parameters=[{'time_scale': time_scale}], condition=IfCondition(use_sim_time)),
         Node(package='tello_driver', executable='tello_driver_main', node_name='tello_driver',
              parameters=tello_driver_params, output='screen'),
     ])
@@ -0,0 +1,23 @@
+from launch import LaunchDescription
+from launch_ros.actions import ComposableNodeContainer
+from launch_ros.descriptions import ComposableNode
+
+
+# Launch the driver and the marker detector in one process
+# The detector takes ownership of the driver's image_gray messages, no copy between nodes
+
+
+def generate_launch_description():
+    ipc = [{'use_intra_process_comms': True}]
+
+    return LaunchDescription([
+        ComposableNodeContainer(
+            name='tello_container', namespace='', package='rclcpp_components', executable='component_container',
+            composable_node_descriptions=[
+                ComposableNode(package='tello_driver', plugin='tello_driver::TelloDriverNode',
+                               name='tello_driver', extra_arguments=ipc),
+                ComposableNode(package='tello_driver', plugin='tello_marker::MarkerDetectorNode',
+                               name='marker_detector', parameters=[{'decimate': 2}], extra_arguments=ipc),
+            ],
+            output='screen'),
+    ])
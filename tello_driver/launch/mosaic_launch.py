@@ -0,0 +1,32 @@
+from launch import LaunchDescription
+from launch_ros.actions import ComposableNodeContainer
+from launch_ros.descriptions import ComposableNode
+
+
+# Launch two drivers and a mosaic in one process
+# Each drone is in AP mode on its own Wi-Fi adapter, the mosaic publishes both streams side by side on /mosaic/image_raw
+
+
+def generate_launch_description():
+    ipc = [{'use_intra_process_comms': True}]
+
+    return LaunchDescription([
+        ComposableNodeContainer(
+            name='tello_container', namespace='', package='rclcpp_components', executable='component_container',
+            composable_node_descriptions=[
+                ComposableNode(package='tello_driver', plugin='tello_driver::TelloDriverNode',
+                               name='tello_driver', namespace='dr1',
+                               parameters=[{'bind_interface': 'wlan1'}], extra_arguments=ipc),
+                ComposableNode(package='tello_driver', plugin='tello_driver::TelloDriverNode',
+                               name='tello_driver', namespace='dr2',
+                               parameters=[{'bind_interface': 'wlan2'}], extra_arguments=ipc),
+                ComposableNode(package='tello_driver', plugin='tello_mosaic::MosaicNode',
+                               name='mosaic', namespace='mosaic',
+                               parameters=[{
+                                   'sources': ['/dr1/tello_driver', '/dr2/tello_driver'],
+                                   'columns': 2,
+                                   'rows': 1,
+                               }], extra_arguments=ipc),
+            ],
+            output='screen'),
+    ])
@@ -0,0 +1,102 @@
+"""
+Read frames from the tello_driver shared memory frame ring, see include/frame_ring.hpp for the layout
+
+Example:
+    ring = FrameRing('tello_frames')
+    frame = ring.latest()
+    if frame is not None:
+        header, pixels = frame      # pixels is a numpy view into shared memory, no copy
+        ...use pixels...
+        if not ring.still_valid(header):
+            ...the driver overwrote the slot while we were using it, discard the results...
+"""
+
+import mmap
+import os
+import struct
+from typing import NamedTuple, Optional, Tuple
+
+import numpy as np
+
+FRAME_RING_MAGIC = 0x47524654
+FRAME_RING_VERSION = 1
+FRAME_RING_OPEN = 1
+
+_RING_HEADER = struct.Struct('<IIIIQQI')
+_SLOT_HEADER = struct.Struct('<QQqqIII20s')
+_RING_HEADER_SIZE = 64
+_SLOT_HEADER_SIZE = 64
+_FRAME_COUNT_OFFSET = 24
+_STATE_OFFSET = 32
+
+_CHANNELS = {'bgr8': 3, 'rgb8': 3, 'mono8': 1}
+
+
+class FrameHeader(NamedTuple):
+    slot: int
+    seq: int
+    frame_number: int
+    stamp_ns: int
+    write_ns: int
+    width: int
+    height: int
+    step: int
+    encoding: str
+
+
+class FrameRing:
+    """Zero-copy reader for the shared memory frame ring"""
+
+    def __init__(self, name: str):
+        path = os.path.join('/dev/shm', name.lstrip('/'))
+        with open(path, 'rb') as f:
+            self._mm = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+
+        magic, version, self.num_slots, self.slot_size, self.slot_stride, _, _ = \
+            _RING_HEADER.unpack_from(self._mm, 0)
+        if magic != FRAME_RING_MAGIC or version != FRAME_RING_VERSION:
+            raise RuntimeError('frame ring %s is not ready or has the wrong version' % name)
+
+        self._buffer = memoryview(self._mm)
+
+    def _u64(self, offset: int) -> int:
+        return struct.unpack_from('<Q', self._mm, offset)[0]
+
+    def frame_count(self) -> int:
+        return self._u64(_FRAME_COUNT_OFFSET)
+
+    def closed(self) -> bool:
+        """True if the driver replaced or closed the ring, re-open to continue"""
+        return struct.unpack_from('<I', self._mm, _STATE_OFFSET)[0] != FRAME_RING_OPEN
+
+    def latest(self) -> Optional[Tuple[FrameHeader, np.ndarray]]:
+        """Map the latest frame, or return None if there are no frames or the driver is writing the slot"""
+        count = self.frame_count()
+        if count == 0:
+            return None
+
+        slot = (count - 1) % self.num_slots
+        offset = _RING_HEADER_SIZE + slot * self.slot_stride
+        seq, frame_number, stamp_ns, write_ns, width, height, step, encoding = \
+            _SLOT_HEADER.unpack_from(self._mm, offset)
+        if seq & 1:
+            return None
+
+        header = FrameHeader(slot, seq, frame_number, stamp_ns, write_ns, width, height, step,
+                             encoding.split(b'\0', 1)[0].decode())
+        if not self.still_valid(header):
+            return None
+
+        channels = _CHANNELS.get(header.encoding, 1)
+        data = offset + _SLOT_HEADER_SIZE
+        pixels = np.ndarray((height, width, channels), dtype=np.uint8, buffer=self._buffer,
+                            offset=data, strides=(step, channels, 1))
+        return header, pixels
+
+    def still_valid(self, header: FrameHeader) -> bool:
+        """True if the driver has not touched the frame since latest() returned it"""
+        return self._u64(_RING_HEADER_SIZE + header.slot * self.slot_stride) == header.seq
+
+    def close(self):
+        self._buffer.release()
+        self._mm.close()
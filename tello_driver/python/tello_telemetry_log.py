@@ -0,0 +1,57 @@
+"""
+Read a columnar telemetry log written by tello_driver, see include/telemetry_log.hpp for the layout
+
+Example:
+    log = TelemetryLog('flight.tlog')
+    t = log.column('t')         # int64 nanoseconds
+    bat = log.column('bat')     # int32 battery %
+"""
+
+import mmap
+import struct
+from typing import Dict, List
+
+import numpy as np
+
+TELEMETRY_LOG_MAGIC = 0x474c5454
+TELEMETRY_LOG_VERSION = 1
+
+_HEADER_SIZE = 4096
+_COLUMNS_OFFSET = 64
+_COLUMN_SIZE = 32
+_DTYPES = {0: np.int32, 1: np.int64, 2: np.float32, 3: np.float64}
+
+
+class TelemetryLog:
+    """Memory-mapped reader for the columnar telemetry log"""
+
+    def __init__(self, path: str):
+        with open(path, 'rb') as f:
+            self._mm = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+
+        magic, version, num_columns, _, self._chunk_size, num_chunks = struct.unpack_from('<IIIIQQ', self._mm, 0)
+        if magic != TELEMETRY_LOG_MAGIC or version != TELEMETRY_LOG_VERSION:
+            raise RuntimeError('%s is not a telemetry log, or has the wrong version' % path)
+        if self._chunk_size == 0:
+            raise RuntimeError('%s has a corrupt header, chunk size is 0' % path)
+
+        # The writer may still be appending, only look at chunks that were mapped
+        self._num_chunks = min(num_chunks, (len(self._mm) - _HEADER_SIZE) // self._chunk_size)
+
+        self._columns: Dict[str, tuple] = {}
+        for i in range(num_columns):
+            name, type_, offset = struct.unpack_from('<24sII', self._mm, _COLUMNS_OFFSET + i * _COLUMN_SIZE)
+            self._columns[name.split(b'\0', 1)[0].decode()] = (_DTYPES[type_], offset)
+
+    def columns(self) -> List[str]:
+        return list(self._columns.keys())
+
+    def column(self, name: str) -> np.ndarray:
+        """Return one column for the whole log, one copy per chunk"""
+        dtype, offset = self._columns[name]
+        parts = []
+        for i in range(self._num_chunks):
+            chunk = _HEADER_SIZE + i * self._chunk_size
+            count = struct.unpack_from('<Q', self._mm, chunk)[0]
+            parts.append(np.frombuffer(self._mm, dtype=dtype, count=count, offset=chunk + offset))
+        return np.concatenate(parts) if parts else np.empty(0, dtype=dtype)
@@ -0,0 +1,63 @@
+#!/usr/bin/env bash
+
+# Fly N emulated AP-mode drones from one host, each behind its own interface.
+#
+# Every emulator runs in its own network namespace at 192.168.10.1 and uses the default
+# ports, just like N real Tellos. The host ends of the veth pairs (tello0, tello1, ...)
+# all have the same address, 192.168.10.2. Each driver uses bind_interface to reach
+# its own drone. Passes if every driver publishes flight_data.
+#
+# Requires root (ip netns), and a sourced workspace with tello_driver installed.
+# Usage: sudo -E ./netns_test.sh [count]
+
+set -e
+
+COUNT=${1:-2}
+PIDS=()
+
+cleanup() {
+  for pid in "${PIDS[@]}"; do
+    kill "$pid" 2>/dev/null || true
+  done
+  for ((i = 0; i < COUNT; i++)); do
+    ip netns delete "tello$i" 2>/dev/null || true
+  done
+  sysctl -q -w net.ipv4.conf.all.rp_filter="$RP_FILTER" || true
+}
+
+# Replies from 192.168.10.1 arrive on every tello interface, strict reverse path filtering would drop them
+RP_FILTER=$(sysctl -n net.ipv4.conf.all.rp_filter)
+trap cleanup EXIT
+sysctl -q -w net.ipv4.conf.all.rp_filter=0
+
+for ((i = 0; i < COUNT; i++)); do
+  ip netns add "tello$i"
+  ip link add "tello$i" type veth peer name eth0 netns "tello$i"
+  ip -n "tello$i" addr add 192.168.10.1/24 dev eth0
+  ip -n "tello$i" link set lo up
+  ip -n "tello$i" link set eth0 up
+  ip addr add 192.168.10.2/24 dev "tello$i"
+  sysctl -q -w "net.ipv4.conf.tello$i.rp_filter=0"
+  ip link set "tello$i" up
+
+  ip netns exec "tello$i" ros2 run tello_driver tello_emulator "tello$i" 8889 8890 11111 &
+  PIDS+=($!)
+
+  ros2 run tello_driver tello_driver_main --ros-args -r __ns:="/drone$i" -p bind_interface:="tello$i" &
+  PIDS+=($!)
+done
+
+# The driver sends "command" once a second, state follows right away
+sleep 5
+
+FAILED=0
+for ((i = 0; i < COUNT; i++)); do
+  if timeout 10 ros2 topic echo --once "/drone$i/flight_data" > /dev/null; then
+    echo "drone$i: receiving flight_data over tello$i"
+  else
+    echo "drone$i: no flight_data over tello$i"
+    FAILED=1
+  fi
+done
+
+exit $FAILED
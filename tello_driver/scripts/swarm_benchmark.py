@@ -0,0 +1,464 @@
+#!/usr/bin/env python3
+
+"""
+Swarm scaling benchmark
+
+Start N emulated drones and N drivers, in the deployment configuration, and measure:
+    total CPU used by the drivers (% of one core)
+    frame rate per drone
+    cmd_vel latency, publish to the emulator receiving the rc command (p50, p99)
+    thread count and RSS of the driver processes
+
+Repeat for each swarm size and write one CSV row per size.
+
+Soak mode runs one swarm size for a long time, e.g., a whole shift, and samples the drivers every minute:
+    RSS, heap and anonymous memory (from /proc/pid/smaps, a proxy for allocator stats), open FDs, threads
+    cmd_vel latency and frame latency (driver stamp to probe) percentiles, frame rate
+At the end fit a line to each metric and fail (exit 1) if any of them drifts the wrong way by more than
+--max_drift over the run, e.g., memory or latency growing, or frame rate falling.
+
+Usage:
+    swarm_benchmark.py [--sizes 1,2,4,8,16,32] [--mode process|container] [--duration 30]
+                       [--video video.h264] [--image] [--output swarm.csv]
+    swarm_benchmark.py --soak 28800 [--sizes 4] [--sample_period 60] [--max_drift 0.1] [--output soak.csv]
+
+Run from the workspace root after sourcing install/setup.bash. Use --video to stream a real h264 file,
+otherwise the emulators send dummy video and the frame rate will be 0.
+"""
+
+import argparse
+import csv
+import os
+import re
+import subprocess
+import sys
+import threading
+import time
+
+import rclpy
+from rclpy.node import Node
+from rclpy.qos import qos_profile_sensor_data
+from rclpy.time import Time
+
+from geometry_msgs.msg import Twist
+from sensor_msgs.msg import CameraInfo, Image
+
+EMULATOR_PATH = 'install/tello_driver/lib/tello_driver/tello_emulator'
+DRIVER_PATH = 'install/tello_driver/lib/tello_driver/tello_driver_main'
+CONTAINER_NAME = 'swarm_container'
+
+# Each drone n uses ports BASE + n, same layout as emulators_launch.py
+DRIVER_CMD_PORT_BASE = 11000
+EMULATOR_PORT_BASE = 12000
+DATA_PORT_BASE = 13000
+VIDEO_PORT_BASE = 14000
+
+# The emulator logs "heard 'rc 0 0 0 42' from 127.0.0.1:11001 at 1234.567890"
+HEARD_RC = re.compile(r"heard 'rc 0 0 0 (-?\d+)' from .* at ([0-9.]+)")
+
+CLK_TCK = os.sysconf('SC_CLK_TCK')
+PAGE_SIZE = os.sysconf('SC_PAGE_SIZE')
+
+
+def percentile(values, p):
+    if not values:
+        return float('nan')
+    values = sorted(values)
+    return values[min(len(values) - 1, int(round(p / 100.0 * (len(values) - 1))))]
+
+
+def linear_drift(times, values):
+    """Least-squares slope times run length, i.e., how much the value drifted over the run"""
+    n = len(times)
+    if n < 2:
+        return 0.0
+    mean_t = sum(times) / n
+    mean_v = sum(values) / n
+    var_t = sum((t - mean_t) ** 2 for t in times)
+    if var_t == 0:
+        return 0.0
+    slope = sum((t - mean_t) * (v - mean_v) for t, v in zip(times, values)) / var_t
+    return slope * (times[-1] - times[0])
+
+
+def driver_params(n):
+    return {
+        'drone_ip': '127.0.0.1',
+        'drone_port': EMULATOR_PORT_BASE + n,
+        'command_port': DRIVER_CMD_PORT_BASE + n,
+        'data_port': DATA_PORT_BASE + n,
+        'video_port': VIDEO_PORT_BASE + n,
+    }
+
+
+def with_descendants(pids):
+    """Add child processes, e.g., 'ros2 run' starts the component container as a child"""
+    result = []
+    while pids:
+        pid = pids.pop()
+        result.append(pid)
+        try:
+            for task in os.listdir('/proc/%d/task' % pid):
+                with open('/proc/%d/task/%s/children' % (pid, task)) as f:
+                    pids += [int(child) for child in f.read().split()]
+        except FileNotFoundError:
+            pass
+    return result
+
+
+class ProcStats:
+    """Sample CPU time, threads and RSS of a set of processes and their children from /proc"""
+
+    def __init__(self, pids):
+        self.pids = with_descendants(list(pids))
+
+    @staticmethod
+    def read(pid):
+        # Fields after the command name, see proc(5): utime=14, stime=15, num_threads=20, rss=24
+        with open('/proc/%d/stat' % pid) as f:
+            fields = f.read().rsplit(')', 1)[1].split()
+        cpu = (int(fields[11]) + int(fields[12])) / CLK_TCK
+        return cpu, int(fields[17]), int(fields[21]) * PAGE_SIZE
+
+    @staticmethod
+    def read_memory(pid):
+        """Return (heap_bytes, anon_bytes, fds), heap is the brk heap, anon includes malloc arenas"""
+        heap = anon = 0
+        mapping = ''
+        with open('/proc/%d/smaps' % pid) as f:
+            for line in f:
+                fields = line.split()
+                if not fields[0].endswith(':'):
+                    # Mapping header: address perms offset dev inode [path]
+                    mapping = fields[5] if len(fields) > 5 else ''
+                elif fields[0] == 'Rss:' and mapping == '[heap]':
+                    heap += int(fields[1]) * 1024
+                elif fields[0] == 'Anonymous:':
+                    anon += int(fields[1]) * 1024
+        return heap, anon, len(os.listdir('/proc/%d/fd' % pid))
+
+    def sample(self):
+        """Return (cpu_seconds, threads, rss_bytes) summed over all processes"""
+        total = [0.0, 0, 0]
+        for pid in self.pids:
+            try:
+                for i, value in enumerate(self.read(pid)):
+                    total[i] += value
+            except (FileNotFoundError, ProcessLookupError):
+                pass
+        return tuple(total)
+
+    def sample_memory(self):
+        """Return (heap_bytes, anon_bytes, fds) summed over all processes"""
+        total = [0, 0, 0]
+        for pid in self.pids:
+            try:
+                for i, value in enumerate(self.read_memory(pid)):
+                    total[i] += value
+            except (FileNotFoundError, ProcessLookupError, PermissionError):
+                pass
+        return tuple(total)
+
+
+class Swarm:
+    """N emulators and N drivers, either one process per driver or one component container"""
+
+    def __init__(self, size, mode, video, time_scale=1.0):
+        self.size = size
+        self.mode = mode
+        self.emulators = []
+        self.drivers = []
+        self.heard = {}  # (drone, k) -> monotonic time the emulator heard 'rc 0 0 0 k'
+        self.lock = threading.Lock()
+
+        for n in range(1, size + 1):
+            cmd = [EMULATOR_PATH, 'em%d' % n, str(EMULATOR_PORT_BASE + n), str(DATA_PORT_BASE + n),
+                   str(VIDEO_PORT_BASE + n), str(time_scale)]
+            if video:
+                cmd.append(video)
+            emulator = subprocess.Popen(cmd, stdout=subprocess.PIPE, stderr=subprocess.DEVNULL, text=True)
+            threading.Thread(target=self._read_emulator, args=(n, emulator), daemon=True).start()
+            self.emulators.append(emulator)
+
+        if mode == 'container':
+            self.drivers.append(subprocess.Popen(
+                ['ros2', 'run', 'rclcpp_components', 'component_container',
+                 '--ros-args', '-r', '__node:=' + CONTAINER_NAME],
+                stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL))
+            time.sleep(2)
+            for n in range(1, size + 1):
+                cmd = ['ros2', 'component', 'load', '/' + CONTAINER_NAME, 'tello_driver',
+                       'tello_driver::TelloDriverNode', '-n', 'dr%d' % n, '--node-namespace', '/dr%d' % n,
+                       '-e', 'use_intra_process_comms:=true']
+                for name, value in driver_params(n).items():
+                    cmd += ['-p', '%s:=%s' % (name, value)]
+                subprocess.run(cmd, stdout=subprocess.DEVNULL, check=True)
+        else:
+            for n in range(1, size + 1):
+                cmd = [DRIVER_PATH, '--ros-args', '-r', '__node:=dr%d' % n, '-r', '__ns:=/dr%d' % n]
+                for name, value in driver_params(n).items():
+                    cmd += ['-p', '%s:=%s' % (name, value)]
+                self.drivers.append(subprocess.Popen(cmd, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL))
+
+    def _read_emulator(self, n, emulator):
+        for line in emulator.stdout:
+            match = HEARD_RC.search(line)
+            if match:
+                with self.lock:
+                    self.heard[(n, int(match.group(1)))] = float(match.group(2))
+
+    def pop_heard(self, n, k):
+        with self.lock:
+            return self.heard.pop((n, k), None)
+
+    def driver_pids(self):
+        return [p.pid for p in self.drivers]
+
+    def stop(self):
+        for p in self.drivers + self.emulators:
+            p.terminate()
+        for p in self.drivers + self.emulators:
+            try:
+                p.wait(timeout=5)
+            except subprocess.TimeoutExpired:
+                p.kill()
+
+
+class Probe(Node):
+    """Count frames and send tagged cmd_vel messages to each drone"""
+
+    def __init__(self, size, subscribe_images):
+        super().__init__('swarm_probe')
+        self.size = size
+        self.frames = [0] * (size + 1)
+        self.frame_latencies = []  # Driver stamp to probe, seconds
+        self.sent = {}  # (drone, k) -> monotonic time cmd_vel was published
+        self.k = 0
+        self.lock = threading.Lock()
+        self.cmd_vel_pubs = {}
+        self.subs = []
+
+        for n in range(1, size + 1):
+            self.cmd_vel_pubs[n] = self.create_publisher(Twist, '/dr%d/cmd_vel' % n, 1)
+            # camera_info is published with every frame, and is much cheaper to receive than image_raw
+            msg_type, topic = (Image, 'image_raw') if subscribe_images else (CameraInfo, 'camera_info')
+            self.subs.append(self.create_subscription(msg_type, '/dr%d/%s' % (n, topic),
+                                                      lambda msg, n=n: self._frame(n, msg), qos_profile_sensor_data))
+
+    def _frame(self, n, msg):
+        latency = (self.get_clock().now() - Time.from_msg(msg.header.stamp)).nanoseconds / 1e9
+        with self.lock:
+            self.frames[n] += 1
+            self.frame_latencies.append(latency)
+
+    def take_frame_latencies(self):
+        with self.lock:
+            latencies, self.frame_latencies = self.frame_latencies, []
+        return latencies
+
+    def take_frames(self):
+        with self.lock:
+            frames, self.frames = self.frames, [0] * (self.size + 1)
+        return frames[1:]
+
+    def send_cmd_vel(self):
+        """Send a cmd_vel with a unique yaw to each drone, the driver will send 'rc 0 0 0 k'"""
+        self.k = self.k % 100 + 1
+        msg = Twist()
+        msg.angular.z = -self.k / 100.0
+        for n, pub in self.cmd_vel_pubs.items():
+            self.sent[(n, self.k)] = time.monotonic()
+            pub.publish(msg)
+
+
+def collect_latencies(probe, swarm, latencies, max_age=1.0):
+    """Match sent cmd_vel messages with rc commands heard by the emulators"""
+    now = time.monotonic()
+    for key, sent in list(probe.sent.items()):
+        heard = swarm.pop_heard(*key)
+        if heard is not None:
+            latencies.append(heard - sent)
+            del probe.sent[key]
+        elif now - sent > max_age:
+            # Dropped, e.g., the driver was waiting for a response to a previous command
+            del probe.sent[key]
+
+
+def spin_for(probe, seconds, cmd_vel_period, swarm, latencies):
+    """Spin the probe, sending cmd_vel messages and collecting latencies"""
+    end = time.monotonic() + seconds
+    next_cmd_vel = time.monotonic()
+    while time.monotonic() < end:
+        rclpy.spin_once(probe, timeout_sec=0.01)
+        if time.monotonic() >= next_cmd_vel:
+            collect_latencies(probe, swarm, latencies)
+            probe.send_cmd_vel()
+            next_cmd_vel += cmd_vel_period
+
+
+def run_size(size, args):
+    swarm = Swarm(size, args.mode, args.video)
+    probe = Probe(size, args.image)
+    try:
+        # Let the drivers connect and the video start
+        latencies = []
+        spin_for(probe, args.warmup, args.cmd_vel_period, swarm, latencies)
+
+        stats = ProcStats(swarm.driver_pids())
+        cpu_start, _, _ = stats.sample()
+        probe.take_frames()
+        latencies.clear()
+        start = time.monotonic()
+
+        spin_for(probe, args.duration, args.cmd_vel_period, swarm, latencies)
+
+        elapsed = time.monotonic() - start
+        cpu_end, threads, rss = stats.sample()
+        fps = [f / elapsed for f in probe.take_frames()]
+
+        return {
+            'size': size,
+            'mode': args.mode,
+            'cpu_percent': round(100.0 * (cpu_end - cpu_start) / elapsed, 1),
+            'fps_min': round(min(fps), 2),
+            'fps_mean': round(sum(fps) / len(fps), 2),
+            'latency_p50_ms': round(1000 * percentile(latencies, 50), 3),
+            'latency_p99_ms': round(1000 * percentile(latencies, 99), 3),
+            'latency_samples': len(latencies),
+            'threads': threads,
+            'rss_mb': round(rss / 1e6, 1),
+        }
+    finally:
+        probe.destroy_node()
+        swarm.stop()
+
+
+# Soak metrics, and the direction that counts as a regression
+SOAK_TRENDS = {
+    'rss_mb': 1,
+    'heap_mb': 1,
+    'anon_mb': 1,
+    'fds': 1,
+    'threads': 1,
+    'cmd_latency_p99_ms': 1,
+    'frame_latency_p99_ms': 1,
+    'fps_mean': -1,
+}
+
+# Ignore drift smaller than this, e.g., 1 fd or 1ms on a small base
+SOAK_MIN_DRIFT = {
+    'fds': 2,
+    'threads': 2,
+    'cmd_latency_p99_ms': 1.0,
+    'frame_latency_p99_ms': 1.0,
+}
+
+
+def run_soak(size, args, out):
+    """Run one swarm size for args.soak seconds, return a list of failed metrics"""
+    swarm = Swarm(size, args.mode, args.video)
+    probe = Probe(size, args.image)
+    try:
+        latencies = []
+        spin_for(probe, args.warmup, args.cmd_vel_period, swarm, latencies)
+
+        stats = ProcStats(swarm.driver_pids())
+        cpu_prev, _, _ = stats.sample()
+        probe.take_frames()
+        probe.take_frame_latencies()
+        start = prev = time.monotonic()
+        rows = []
+        writer = None
+
+        while time.monotonic() - start < args.soak:
+            latencies.clear()
+            spin_for(probe, args.sample_period, args.cmd_vel_period, swarm, latencies)
+
+            now = time.monotonic()
+            cpu, threads, rss = stats.sample()
+            heap, anon, fds = stats.sample_memory()
+            fps = [f / (now - prev) for f in probe.take_frames()]
+            frame_latencies = probe.take_frame_latencies()
+
+            row = {
+                'minutes': round((now - start) / 60, 2),
+                'cpu_percent': round(100.0 * (cpu - cpu_prev) / (now - prev), 1),
+                'rss_mb': round(rss / 1e6, 2),
+                'heap_mb': round(heap / 1e6, 2),
+                'anon_mb': round(anon / 1e6, 2),
+                'fds': fds,
+                'threads': threads,
+                'fps_mean': round(sum(fps) / len(fps), 2),
+                'cmd_latency_p50_ms': round(1000 * percentile(latencies, 50), 3),
+                'cmd_latency_p99_ms': round(1000 * percentile(latencies, 99), 3),
+                'frame_latency_p50_ms': round(1000 * percentile(frame_latencies, 50), 3),
+                'frame_latency_p99_ms': round(1000 * percentile(frame_latencies, 99), 3),
+            }
+            rows.append(row)
+            cpu_prev, prev = cpu, now
+
+            if writer is None:
+                writer = csv.DictWriter(out, fieldnames=list(row.keys()))
+                writer.writeheader()
+            writer.writerow(row)
+            out.flush()
+
+        # Fit a line to each metric, skip nan percentiles, e.g., no video
+        failed = []
+        for metric, direction in SOAK_TRENDS.items():
+            points = [(r['minutes'], r[metric]) for r in rows if r[metric] == r[metric]]
+            if len(points) < 3:
+                continue
+            times, values = zip(*points)
+            drift = direction * linear_drift(times, values)
+            base = abs(values[0])
+            if drift > max(args.max_drift * base, SOAK_MIN_DRIFT.get(metric, 0)):
+                failed.append('%s drifted from %g by %+g' % (metric, values[0], direction * drift))
+        return failed
+    finally:
+        probe.destroy_node()
+        swarm.stop()
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Measure how driver cost scales with the number of drones')
+    parser.add_argument('--sizes', default='1,2,4,8,16,32', help='comma-separated swarm sizes')
+    parser.add_argument('--mode', choices=['process', 'container'], default='process',
+                        help='one driver process per drone, or all drivers in one component container')
+    parser.add_argument('--duration', type=float, default=30.0, help='measurement time per size, seconds')
+    parser.add_argument('--warmup', type=float, default=10.0, help='time to connect and start video, seconds')
+    parser.add_argument('--cmd_vel_period', type=float, default=0.1, help='time between cmd_vel messages, seconds')
+    parser.add_argument('--video', default='', help='h264 file streamed by the emulators')
+    parser.add_argument('--image', action='store_true', help='subscribe to image_raw instead of camera_info')
+    parser.add_argument('--output', default='', help='CSV file, default is stdout')
+    parser.add_argument('--soak', type=float, default=0.0, help='soak for this many seconds, uses the first size')
+    parser.add_argument('--sample_period', type=float, default=60.0, help='time between soak samples, seconds')
+    parser.add_argument('--max_drift', type=float, default=0.1,
+                        help='fail the soak if a metric drifts by more than this fraction of its first sample')
+    args = parser.parse_args()
+
+    rclpy.init()
+
+    out = open(args.output, 'w', newline='') if args.output else sys.stdout
+
+    if args.soak > 0:
+        failed = run_soak(int(args.sizes.split(',')[0]), args, out)
+        rclpy.shutdown()
+        for failure in failed:
+            print('FAIL: ' + failure, file=sys.stderr)
+        sys.exit(1 if failed else 0)
+
+    writer = None
+    for size in [int(s) for s in args.sizes.split(',')]:
+        row = run_size(size, args)
+        if writer is None:
+            writer = csv.DictWriter(out, fieldnames=list(row.keys()))
+            writer.writeheader()
+        writer.writerow(row)
+        out.flush()
+
+    rclpy.shutdown()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,45 @@
+#include "tello_controller.hpp"
+
+#include <algorithm>
+
+#include "pluginlib/class_list_macros.hpp"
+
+namespace tello_driver
+{
+
+  //=====================================================================================
+  // Example controller: hold altitude with a P controller on h, leave the other axes alone
+  //=====================================================================================
+
+  class AltitudeHoldController : public Controller
+  {
+    int target_ = 100;        // Height in cm
+    double kp_ = 0.5;         // Joystick position per cm of error
+    int max_ud_ = 50;         // Limit the joystick position
+
+  public:
+
+    void initialize(rclcpp::Node &node) override
+    {
+      target_ = node.declare_parameter<int>("altitude_hold.target", target_);
+      kp_ = node.declare_parameter<double>("altitude_hold.kp", kp_);
+      max_ud_ = node.declare_parameter<int>("altitude_hold.max_ud", max_ud_);
+      RCLCPP_INFO(node.get_logger(), "Holding altitude at %dcm", target_);
+    }
+
+    bool update(const tello_msgs::msg::FlightData &state, RcSetpoint &setpoint) override
+    {
+      // h is 0 on the ground, the drone ignores rc until it takes off
+      if (state.h <= 0) {
+        return false;
+      }
+
+      int ud = static_cast<int>(kp_ * (target_ - state.h));
+      setpoint.ud = std::max(-max_ud_, std::min(max_ud_, ud));
+      return true;
+    }
+  };
+
+} // namespace tello_driver
+
+PLUGINLIB_EXPORT_CLASS(tello_driver::AltitudeHoldController, tello_driver::Controller)
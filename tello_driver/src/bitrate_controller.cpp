@@ -0,0 +1,63 @@
+#include "tello_driver_node.hpp"
+
+namespace tello_driver
+{
+
+  // Bitrate ladder, from most to least robust. Bitrate is in Mbps, see setbitrate in the SDK.
+  struct BitrateLevel
+  {
+    int bitrate;
+    const char *resolution;
+  };
+
+  static const std::vector<BitrateLevel> LADDER{
+    {1, "low"},
+    {2, "low"},
+    {3, "high"},
+    {4, "high"},
+    {5, "high"}};
+
+  BitrateController::BitrateController(const Config &config) :
+    config_(config), level_(static_cast<int>(LADDER.size()) - 1)
+  {}
+
+  bool BitrateController::update(const VideoStats &stats, int snr, std::vector<std::string> &commands)
+  {
+    // Nothing to judge
+    if (stats.sequences == 0) {
+      return false;
+    }
+
+    double error_rate = static_cast<double>(stats.dropped + stats.errors) / stats.sequences;
+    bool snr_known = snr >= 0;
+
+    bool bad = error_rate > config_.error_high || (snr_known && snr < config_.snr_low);
+    bool good = error_rate < config_.error_low && (!snr_known || snr > config_.snr_high);
+
+    // Between the thresholds both counters reset, this is the hysteresis band
+    bad_ = bad ? bad_ + 1 : 0;
+    good_ = good ? good_ + 1 : 0;
+
+    int next = level_;
+    if (bad_ >= config_.down_count && level_ > 0) {
+      next = level_ - 1;
+    } else if (good_ >= config_.up_count && level_ < static_cast<int>(LADDER.size()) - 1) {
+      next = level_ + 1;
+    }
+
+    if (next == level_) {
+      return false;
+    }
+
+    if (std::string(LADDER[next].resolution) != LADDER[level_].resolution) {
+      commands.push_back(std::string("setresolution ") + LADDER[next].resolution);
+    }
+    commands.push_back("setbitrate " + std::to_string(LADDER[next].bitrate));
+
+    level_ = next;
+    bad_ = 0;
+    good_ = 0;
+    return true;
+  }
+
+} // namespace tello_driver
@@ -0,0 +1,307 @@
+#include "black_box.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+namespace tello_driver
+{
+
+  constexpr double CRASH_REARM = 0.5;       // Re-arm the crash trigger below this fraction of crash_accel
+  constexpr int BATTERY_REARM = 5;          // Re-arm the battery trigger this many percent above low_battery
+
+  BlackBox::BlackBox(const Config &config, Log log) :
+    config_(config), log_(std::move(log))
+  {
+#if LIBAVFORMAT_VERSION_MAJOR < 58
+    av_register_all();
+#endif
+  }
+
+  BlackBox::~BlackBox()
+  {
+    std::lock_guard<std::mutex> lock(dump_mtx_);
+    if (writer_.joinable()) {
+      writer_.join();
+    }
+  }
+
+  void BlackBox::on_access_unit(const AccessUnit &au, CoreClock::time_point time)
+  {
+    // Copy outside the lock
+    auto data = std::make_shared<const std::vector<unsigned char>>(au.data, au.data + au.size);
+
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    // Nothing before the first keyframe can be decoded
+    if (units_.empty() && !au.keyframe) {
+      return;
+    }
+
+    if (au.keyframe) {
+      width_ = au.width;
+      height_ = au.height;
+    }
+
+    bytes_ += data->size();
+    video_bytes_ += data->size();
+    units_.push_back(Unit{std::move(data), au.keyframe, time});
+    evict(time);
+  }
+
+  void BlackBox::on_state(const std::string &raw, CoreClock::time_point time)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      bytes_ += raw.size();
+      states_.push_back(State{raw, time});
+      evict(time);
+    }
+
+    if (config_.crash_accel > 0 || config_.low_battery > 0) {
+      check_triggers(raw);
+    }
+  }
+
+  // Drop whole GOPs from the front, but never the most recent one
+  void BlackBox::evict(CoreClock::time_point now)
+  {
+    auto window = std::chrono::duration_cast<CoreClock::duration>(std::chrono::duration<double>(config_.max_seconds));
+
+    while (!units_.empty() && (bytes_ > config_.max_bytes || now - units_.front().time > window)) {
+      auto next = std::find_if(units_.begin() + 1, units_.end(), [](const Unit &unit) { return unit.keyframe; });
+      if (next == units_.end()) {
+        break;
+      }
+      for (auto i = units_.begin(); i != next; ++i) {
+        bytes_ -= i->data->size();
+        video_bytes_ -= i->data->size();
+      }
+      units_.erase(units_.begin(), next);
+    }
+
+    // If the most recent GOP alone is over the budget, keep the telemetry that goes with it
+    bool over_budget = bytes_ > config_.max_bytes && video_bytes_ <= config_.max_bytes;
+
+    while (!states_.empty() && (over_budget || now - states_.front().time > window)) {
+      bytes_ -= states_.front().raw.size();
+      states_.pop_front();
+      over_budget = bytes_ > config_.max_bytes;
+    }
+  }
+
+  void BlackBox::check_triggers(const std::string &raw)
+  {
+    auto fields = TelloCore::parse_fields(raw);
+    std::string reason;
+
+    try {
+      if (config_.crash_accel > 0 && fields.count("agx") && fields.count("agy") && fields.count("agz")) {
+        double agx = std::stod(fields["agx"]);
+        double agy = std::stod(fields["agy"]);
+        double agz = std::stod(fields["agz"]);
+        double accel = std::sqrt(agx * agx + agy * agy + agz * agz);
+
+        if (!crashed_ && accel > config_.crash_accel) {
+          crashed_ = true;
+          reason = "crash";
+        } else if (crashed_ && accel < CRASH_REARM * config_.crash_accel) {
+          crashed_ = false;
+        }
+      }
+
+      if (config_.low_battery > 0 && fields.count("bat")) {
+        int bat = std::stoi(fields["bat"]);
+
+        if (!battery_low_ && bat < config_.low_battery) {
+          battery_low_ = true;
+          if (reason.empty()) {
+            reason = "low_battery";
+          }
+        } else if (battery_low_ && bat >= config_.low_battery + BATTERY_REARM) {
+          battery_low_ = false;
+        }
+      }
+    } catch (std::exception &e) {
+      // Unparseable state, the flight data publisher reports it
+      return;
+    }
+
+    if (!reason.empty()) {
+      log_(LogLevel::warn, "Black box triggered by " + reason);
+      std::string video_path, telemetry_path;
+      dump(reason, video_path, telemetry_path);
+    }
+  }
+
+  BlackBox::Result BlackBox::dump(const std::string &reason, std::string &video_path, std::string &telemetry_path)
+  {
+    std::lock_guard<std::mutex> dump_lock(dump_mtx_);
+
+    if (writing_) {
+      log_(LogLevel::warn, "Black box is busy writing, dropping dump");
+      return Result::busy;
+    }
+
+    std::deque<Unit> units;
+    std::deque<State> states;
+    int width, height;
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      units = units_;
+      states = states_;
+      width = width_;
+      height = height_;
+    }
+
+    if (units.empty()) {
+      return Result::empty;
+    }
+
+    // E.g., blackbox_20240102_030405_crash.mp4
+    char stamp[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", std::localtime(&now));
+
+    std::string name = reason.empty() ? "manual" : reason;
+    std::replace_if(name.begin(), name.end(), [](char c) { return !std::isalnum(static_cast<unsigned char>(c)); }, '_');
+
+    std::string base = config_.dir + "/blackbox_" + stamp + "_" + name;
+    video_path = base + ".mp4";
+    telemetry_path = base + ".csv";
+
+    // The previous writer has finished
+    if (writer_.joinable()) {
+      writer_.join();
+    }
+
+    writing_ = true;
+    writer_ = std::thread(&BlackBox::write, this, std::move(units), std::move(states), width, height,
+                          video_path, telemetry_path);
+    return Result::ok;
+  }
+
+  // Runs on the writer thread
+  void BlackBox::write(std::deque<Unit> units, std::deque<State> states, int width, int height,
+                       std::string video_path, std::string telemetry_path)
+  {
+    auto start = units.front().time;
+    double seconds = std::chrono::duration<double>(units.back().time - start).count();
+
+    if (write_video(units, width, height, video_path) && write_telemetry(states, start, telemetry_path)) {
+      log_(LogLevel::info, "Black box wrote " + std::to_string(static_cast<int>(seconds)) + "s to " + video_path +
+                           " and " + telemetry_path);
+    }
+
+    writing_ = false;
+  }
+
+  // Tello sends Annex B with SPS and PPS before each keyframe, the mp4 muxer builds avcC from the first packet
+  bool BlackBox::write_video(const std::deque<Unit> &units, int width, int height, const std::string &path)
+  {
+    AVFormatContext *context = nullptr;
+    if (avformat_alloc_output_context2(&context, nullptr, "mp4", path.c_str()) < 0 || !context) {
+      log_(LogLevel::error, "Can't create " + path);
+      return false;
+    }
+
+    AVStream *stream = avformat_new_stream(context, nullptr);
+    if (!stream) {
+      log_(LogLevel::error, "Can't create a stream in " + path);
+      avformat_free_context(context);
+      return false;
+    }
+
+    const AVRational microseconds{1, 1000000};
+    stream->time_base = microseconds;
+    stream->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+    stream->codecpar->codec_id = AV_CODEC_ID_H264;
+    stream->codecpar->width = width;
+    stream->codecpar->height = height;
+
+    bool ok = false;
+
+    if (avio_open(&context->pb, path.c_str(), AVIO_FLAG_WRITE) < 0) {
+      log_(LogLevel::error, "Can't open " + path);
+    } else {
+      // The muxer may pick another time base
+      if (avformat_write_header(context, nullptr) < 0) {
+        log_(LogLevel::error, "Can't write the header of " + path);
+      } else {
+        ok = true;
+        int64_t last = -1;
+
+        for (const auto &unit : units) {
+          // Frames decoded from one sequence arrive together, timestamps must increase
+          int64_t t = std::chrono::duration_cast<std::chrono::microseconds>(unit.time - units.front().time).count();
+          t = std::max(t, last + 1);
+          last = t;
+
+          AVPacket packet;
+          av_init_packet(&packet);
+          packet.data = const_cast<uint8_t *>(unit.data->data());
+          packet.size = static_cast<int>(unit.data->size());
+          packet.stream_index = stream->index;
+          packet.flags = unit.keyframe ? AV_PKT_FLAG_KEY : 0;
+          packet.pts = packet.dts = av_rescale_q(t, microseconds, stream->time_base);
+
+          if (av_write_frame(context, &packet) < 0) {
+            log_(LogLevel::error, "Can't write a frame to " + path);
+            ok = false;
+            break;
+          }
+        }
+
+        av_write_trailer(context);
+      }
+
+      avio_closep(&context->pb);
+    }
+
+    avformat_free_context(context);
+    return ok;
+  }
+
+  // One row per state packet, columns are the fields of the first packet
+  bool BlackBox::write_telemetry(const std::deque<State> &states, CoreClock::time_point start,
+                                 const std::string &path)
+  {
+    std::ofstream file(path);
+    if (!file) {
+      log_(LogLevel::error, "Can't open " + path);
+      return false;
+    }
+
+    std::vector<std::string> keys;
+    if (!states.empty()) {
+      for (const auto &field : TelloCore::parse_fields(states.front().raw)) {
+        keys.push_back(field.first);
+      }
+    }
+
+    file << "t";
+    for (const auto &key : keys) {
+      file << "," << key;
+    }
+    file << "\n";
+
+    for (const auto &state : states) {
+      auto fields = TelloCore::parse_fields(state.raw);
+      file << std::chrono::duration<double>(state.time - start).count();
+      for (const auto &key : keys) {
+        auto i = fields.find(key);
+        file << "," << (i == fields.end() ? "" : i->second);
+      }
+      file << "\n";
+    }
+
+    return static_cast<bool>(file);
+  }
+
+} // namespace tello_driver
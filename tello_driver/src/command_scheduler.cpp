@@ -0,0 +1,226 @@
+#include "command_scheduler.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <ctime>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace tello_driver
+{
+
+  constexpr int64_t WHEEL_TICK_NS = 1000000;      // 1ms slots
+  constexpr size_t WHEEL_SLOTS = 4096;            // About 4s horizon
+  constexpr int64_t SLEEP_MARGIN_NS = 2000000;    // Wake from the condition variable this early
+  constexpr int64_t SPIN_NS = 50000;              // Spin for the last 50us
+  constexpr int SCHEDULER_PRIORITY = 80;          // SCHED_FIFO priority
+
+  CommandScheduler &CommandScheduler::instance()
+  {
+    static CommandScheduler scheduler;
+    return scheduler;
+  }
+
+  CommandScheduler::CommandScheduler() :
+    wheel_(WHEEL_SLOTS), cursor_tick_(now_ns() / WHEEL_TICK_NS)
+  {
+    thread_ = std::thread(&CommandScheduler::run, this);
+
+    // Requires CAP_SYS_NICE or an rtprio limit, otherwise run at normal priority
+    sched_param param{};
+    param.sched_priority = SCHEDULER_PRIORITY;
+    realtime_ = pthread_setschedparam(thread_.native_handle(), SCHED_FIFO, &param) == 0;
+  }
+
+  CommandScheduler::~CommandScheduler()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      stopping_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+  }
+
+  int64_t CommandScheduler::now_ns()
+  {
+    timespec ts{};
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+  }
+
+  void CommandScheduler::schedule(const void *owner, int64_t target_ns, Fire fire, Report report)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      insert(Entry{owner, target_ns, std::move(fire), std::move(report)});
+    }
+    cv_.notify_all();
+  }
+
+  void CommandScheduler::cancel(const void *owner)
+  {
+    std::unique_lock<std::mutex> lock(mtx_);
+
+    for (auto &slot : wheel_) {
+      auto end = std::remove_if(slot.begin(), slot.end(), [owner](const Entry &e) { return e.owner == owner; });
+      wheel_count_ -= slot.end() - end;
+      slot.erase(end, slot.end());
+    }
+
+    for (auto i = overflow_.begin(); i != overflow_.end();) {
+      i = i->second.owner == owner ? overflow_.erase(i) : std::next(i);
+    }
+
+    // The batch may be sleeping until an entry for owner, skip those entries and their reports
+    for (auto &entry : batch_) {
+      if (entry.owner == owner) {
+        entry.canceled = true;
+      }
+    }
+
+    idle_cv_.wait(lock, [this, owner] { return calling_ != owner; });
+  }
+
+  // mtx_ must be held
+  void CommandScheduler::insert(Entry &&entry)
+  {
+    // Late entries go in the current slot, they fire right away
+    int64_t tick = std::max(entry.target_ns / WHEEL_TICK_NS, cursor_tick_);
+
+    if (tick - cursor_tick_ < static_cast<int64_t>(WHEEL_SLOTS)) {
+      wheel_[tick % WHEEL_SLOTS].push_back(std::move(entry));
+      wheel_count_++;
+    } else {
+      int64_t target_ns = entry.target_ns;
+      overflow_.emplace(target_ns, std::move(entry));
+    }
+  }
+
+  void CommandScheduler::run()
+  {
+    std::unique_lock<std::mutex> lock(mtx_);
+
+    while (!stopping_) {
+      int64_t now = now_ns();
+      int64_t now_tick = now / WHEEL_TICK_NS;
+
+      // Skip empty slots up to the current tick, but never past it: insert() puts late entries
+      // in the cursor slot, which must not be a future slot
+      if (wheel_count_ == 0) {
+        cursor_tick_ = std::max(cursor_tick_, now_tick);
+      }
+      while (cursor_tick_ < now_tick && wheel_[cursor_tick_ % WHEEL_SLOTS].empty()) {
+        cursor_tick_++;
+      }
+
+      // Move overflow entries that are now within the horizon
+      while (!overflow_.empty() &&
+             overflow_.begin()->first / WHEEL_TICK_NS - cursor_tick_ < static_cast<int64_t>(WHEEL_SLOTS)) {
+        Entry entry = std::move(overflow_.begin()->second);
+        overflow_.erase(overflow_.begin());
+        insert(std::move(entry));
+      }
+
+      if (wheel_count_ == 0) {
+        if (overflow_.empty()) {
+          cv_.wait(lock);
+        } else {
+          auto wake = std::chrono::system_clock::time_point{std::chrono::nanoseconds{
+            overflow_.begin()->first - static_cast<int64_t>(WHEEL_SLOTS / 2) * WHEEL_TICK_NS}};
+          cv_.wait_until(lock, wake);
+        }
+        continue;
+      }
+
+      // Find the first non-empty slot without moving the cursor
+      int64_t tick = cursor_tick_;
+      while (wheel_[tick % WHEEL_SLOTS].empty()) {
+        tick++;
+      }
+      auto &slot = wheel_[tick % WHEEL_SLOTS];
+      int64_t earliest = std::min_element(slot.begin(), slot.end(), [](const Entry &a, const Entry &b)
+      {
+        return a.target_ns < b.target_ns;
+      })->target_ns;
+
+      // Far away: sleep on the condition variable, schedule() may add an earlier entry
+      if (earliest - now > SLEEP_MARGIN_NS) {
+        cv_.wait_until(lock, std::chrono::system_clock::time_point{
+          std::chrono::nanoseconds{earliest - SLEEP_MARGIN_NS}});
+        continue;
+      }
+
+      // Close, but the slot's tick hasn't arrived: wait for it, schedule() may still add an earlier entry
+      if (tick > now_tick) {
+        cv_.wait_until(lock, std::chrono::system_clock::time_point{std::chrono::nanoseconds{tick * WHEEL_TICK_NS}});
+        continue;
+      }
+
+      // Arrived: take the slot and fire it in target order, the entries are at most 1ms apart
+      batch_.swap(slot);
+      wheel_count_ -= batch_.size();
+      cursor_tick_ = tick;
+      std::sort(batch_.begin(), batch_.end(), [](const Entry &a, const Entry &b)
+      {
+        return a.target_ns < b.target_ns;
+      });
+      fire_batch(lock);
+    }
+  }
+
+  void CommandScheduler::fire_batch(std::unique_lock<std::mutex> &lock)
+  {
+    std::vector<int64_t> actual(batch_.size());
+    std::vector<bool> sent(batch_.size());
+
+    for (size_t i = 0; i < batch_.size(); ++i) {
+      int64_t target = batch_[i].target_ns;
+      lock.unlock();
+
+      if (target - now_ns() > SPIN_NS) {
+        timespec ts{};
+        ts.tv_sec = (target - SPIN_NS) / 1000000000;
+        ts.tv_nsec = (target - SPIN_NS) % 1000000000;
+        while (clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &ts, nullptr) == EINTR) {}
+      }
+
+      while (now_ns() < target) {}
+
+      // cancel() may have run while we slept
+      lock.lock();
+      if (batch_[i].canceled) {
+        continue;
+      }
+      calling_ = batch_[i].owner;
+      lock.unlock();
+
+      sent[i] = batch_[i].fire();
+      actual[i] = now_ns();
+
+      lock.lock();
+      calling_ = nullptr;
+      idle_cv_.notify_all();
+    }
+
+    // Reports aren't time-critical
+    for (size_t i = 0; i < batch_.size(); ++i) {
+      if (batch_[i].canceled || !batch_[i].report) {
+        continue;
+      }
+      calling_ = batch_[i].owner;
+      lock.unlock();
+
+      batch_[i].report(sent[i], actual[i]);
+
+      lock.lock();
+      calling_ = nullptr;
+      idle_cv_.notify_all();
+    }
+
+    batch_.clear();
+  }
+
+} // namespace tello_driver
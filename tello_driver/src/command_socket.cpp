@@ -1,13 +1,12 @@
-#include "tello_driver_node.hpp"
+#include "tello_core.hpp"
 
 namespace tello_driver
 {
 
-  CommandSocket::CommandSocket(TelloDriverNode *driver, std::string drone_ip,
+  CommandSocket::CommandSocket(TelloCore *core, const SocketBinding &binding, const std::string &drone_ip,
                                unsigned short drone_port, unsigned short command_port) :
-    TelloSocket(driver, command_port),
-    remote_endpoint_(asio::ip::address_v4::from_string(drone_ip), drone_port),
-    send_time_(rclcpp::Time(0L, RCL_ROS_TIME))
+    TelloSocket(core, binding, command_port),
+    remote_endpoint_(asio::ip::address_v4::from_string(drone_ip), drone_port)
   {
     buffer_ = std::vector<unsigned char>(1024);
     listen();
@@ -15,11 +14,25 @@ namespace tello_driver
 
   void CommandSocket::timeout()
   {
-    std::lock_guard<std::mutex> lock(mtx_);
-    receiving_ = false;
+    bool completed = false;
+    std::string command;
+    bool respond = false;
 
-    if (waiting_) {
-      complete_command(tello_msgs::msg::TelloResponse::TIMEOUT, "error: command timed out");
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      receiving_ = false;
+
+      if (waiting_) {
+        waiting_ = false;
+        completed = true;
+        command = command_;
+        respond = respond_;
+      }
+    }
+
+    // Outside the lock, the callback may send the next command
+    if (completed && core_->callbacks().response) {
+      core_->callbacks().response(command, CommandResult::timeout, "error: command timed out", respond);
     }
   }
 
@@ -29,57 +42,67 @@ namespace tello_driver
     return waiting_;
   }
 
-  rclcpp::Time CommandSocket::send_time()
+  uint64_t CommandSocket::sent()
   {
     std::lock_guard<std::mutex> lock(mtx_);
-    return send_time_;
+    return sent_;
   }
 
-  void CommandSocket::initiate_command(std::string command, bool respond)
+  bool CommandSocket::initiate_command(const std::string &command, bool respond)
   {
     std::lock_guard<std::mutex> lock(mtx_);
 
-    if (!waiting_) {
-      RCLCPP_DEBUG(driver_->get_logger(), "Sending '%s'...", command.c_str());
+    if (waiting_) {
+      return false;
+    } else {
+      // Scheduled sends are timing critical, don't build the message unless it's logged
+      if (core_->log_enabled(LogLevel::debug)) {
+        core_->log(LogLevel::debug, "Sending '" + command + "'...");
+      }
       socket_.send_to(asio::buffer(command), remote_endpoint_);
-      send_time_ = driver_->now();
+      sent_++;
+      command_ = command;
 
       // Wait for a response for all commands except "rc"
       if (command.rfind("rc", 0) != 0) {
         respond_ = respond;
         waiting_ = true;
       }
+      return true;
     }
   }
 
-  void CommandSocket::complete_command(uint8_t rc, std::string str)
-  {
-    if (respond_) {
-      tello_msgs::msg::TelloResponse response_msg;
-      response_msg.rc = rc;
-      response_msg.str = str;
-      driver_->tello_response_pub_->publish(response_msg);
-    }
-    waiting_ = false;
-  }
-
   void CommandSocket::process_packet(size_t r)
   {
-    std::lock_guard<std::mutex> lock(mtx_);
+    std::string str = std::string(buffer_.begin(), buffer_.begin() + r);
+    CommandResult result = str == "error" ? CommandResult::error : CommandResult::ok;
+    bool completed = false;
+    std::string command;
+    bool respond = false;
+
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
 
-    receive_time_ = driver_->now();
+      note_packet();
 
-    if (!receiving_) {
-      receiving_ = true;
+      if (waiting_) {
+        waiting_ = false;
+        completed = true;
+        command = command_;
+        respond = respond_;
+      }
     }
 
-    std::string str = std::string(buffer_.begin(), buffer_.begin() + r);
-    if (waiting_) {
-      RCLCPP_DEBUG(driver_->get_logger(), "Received '%s'", str.c_str());
-      complete_command(str == "error" ? tello_msgs::msg::TelloResponse::ERROR : tello_msgs::msg::TelloResponse::OK,
-                       str);
+    // Outside the lock, the callback may send the next command
+    if (!completed) {
+      core_->log(LogLevel::warn, "Unexpected '" + str + "'");
     } else {
-      RCLCPP_WARN(driver_->get_logger(), "Unexpected '%s'", str.c_str());
+      if (core_->log_enabled(LogLevel::debug)) {
+        core_->log(LogLevel::debug, "Received '" + str + "'");
+      }
+      if (core_->callbacks().response) {
+        core_->callbacks().response(command, result, str, respond);
+      }
     }
   }
 
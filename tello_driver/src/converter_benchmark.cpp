@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "h264decoder.hpp"
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/pixfmt.h>
+}
+
+//=====================================================================================
+// Measure YUV420P -> BGR24 conversion latency for 1..N stripes
+//
+// Usage: converter_benchmark [width height max_stripes iterations]
+//=====================================================================================
+
+int main(int argc, char *argv[])
+{
+  int width = 960;
+  int height = 720;
+  int max_stripes = static_cast<int>(std::thread::hardware_concurrency());
+  int iterations = 500;
+
+  if (argc == 5) {
+    width = std::stoi(argv[1]);
+    height = std::stoi(argv[2]);
+    max_stripes = std::stoi(argv[3]);
+    iterations = std::stoi(argv[4]);
+  }
+
+  // Synthetic frame with a gradient, the content doesn't affect sws_scale timing
+  AVFrame *frame = av_frame_alloc();
+  frame->width = width;
+  frame->height = height;
+  frame->format = AV_PIX_FMT_YUV420P;
+  if (av_frame_get_buffer(frame, 32) < 0) {
+    std::cerr << "Cannot allocate frame" << std::endl;
+    return 1;
+  }
+  for (int plane = 0; plane < 3; ++plane) {
+    int h = plane == 0 ? height : height / 2;
+    for (int y = 0; y < h; ++y) {
+      std::fill_n(frame->data[plane] + y * frame->linesize[plane], frame->linesize[plane], y & 0xff);
+    }
+  }
+
+  std::cout << width << "x" << height << ", " << iterations << " iterations" << std::endl;
+  std::cout << "stripes   mean ms    p50 ms    p99 ms   speedup" << std::endl;
+
+  double baseline = 0;
+
+  for (int stripes = 1; stripes <= max_stripes; ++stripes) {
+    ConverterRGB24 converter;
+    converter.set_stripes(stripes);
+    std::vector<unsigned char> bgr(converter.predict_size(width, height));
+
+    // Warm up caches and sws contexts
+    for (int i = 0; i < 10; ++i) {
+      converter.convert(*frame, bgr.data());
+    }
+
+    std::vector<double> ms;
+    ms.reserve(iterations);
+    for (int i = 0; i < iterations; ++i) {
+      auto start = std::chrono::steady_clock::now();
+      converter.convert(*frame, bgr.data());
+      ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    double mean = 0;
+    for (double m : ms) {
+      mean += m;
+    }
+    mean /= ms.size();
+    std::sort(ms.begin(), ms.end());
+    if (stripes == 1) {
+      baseline = mean;
+    }
+
+    std::cout << std::fixed << std::setprecision(3)
+              << std::setw(7) << stripes
+              << std::setw(10) << mean
+              << std::setw(10) << ms[ms.size() / 2]
+              << std::setw(10) << ms[ms.size() * 99 / 100]
+              << std::setw(10) << baseline / mean << std::endl;
+  }
+
+  av_frame_free(&frame);
+  return 0;
+}
@@ -0,0 +1,182 @@
+#include "tello_driver_node.hpp"
+
+namespace tello_driver
+{
+
+  // Telemetry log columns, must match the order in log_sample()
+  static const std::vector<TelemetryColumn> LOG_COLUMNS{
+    {"t",     TelemetryType::INT64},      // Receive time in ns
+    {"sdk",   TelemetryType::INT32},
+    {"pitch", TelemetryType::INT32},
+    {"roll",  TelemetryType::INT32},
+    {"yaw",   TelemetryType::INT32},
+    {"vgx",   TelemetryType::INT32},
+    {"vgy",   TelemetryType::INT32},
+    {"vgz",   TelemetryType::INT32},
+    {"templ", TelemetryType::INT32},
+    {"temph", TelemetryType::INT32},
+    {"tof",   TelemetryType::INT32},
+    {"h",     TelemetryType::INT32},
+    {"bat",   TelemetryType::INT32},
+    {"baro",  TelemetryType::FLOAT32},
+    {"time",  TelemetryType::INT32},
+    {"agx",   TelemetryType::FLOAT32},
+    {"agy",   TelemetryType::FLOAT32},
+    {"agz",   TelemetryType::FLOAT32},
+    {"mid",   TelemetryType::INT32},
+    {"x",     TelemetryType::INT32},
+    {"y",     TelemetryType::INT32},
+    {"z",     TelemetryType::INT32}};
+
+  FlightDataPublisher::FlightDataPublisher(TelloDriverNode *driver, const std::string &telemetry_log_path) :
+    driver_(driver)
+  {
+    if (!telemetry_log_path.empty()) {
+      try {
+        telemetry_log_ = std::make_unique<TelemetryLogWriter>(telemetry_log_path, LOG_COLUMNS);
+        RCLCPP_INFO(driver_->get_logger(), "Logging telemetry to %s", telemetry_log_path.c_str());
+      } catch (std::exception &e) {
+        RCLCPP_ERROR(driver_->get_logger(), "%s", e.what());
+      }
+    }
+  }
+
+  void FlightDataPublisher::log_sample(const tello_msgs::msg::FlightData &msg)
+  {
+    // Growing the log can fail, e.g., the disk is full, stop logging but keep flying
+    try {
+      telemetry_log_->begin_sample();
+    } catch (std::exception &e) {
+      RCLCPP_ERROR(driver_->get_logger(), "%s, telemetry logging stopped", e.what());
+      telemetry_log_.reset();
+      return;
+    }
+
+    size_t c = 0;
+    telemetry_log_->set(c++, static_cast<int64_t>(rclcpp::Time(msg.header.stamp).nanoseconds()));
+    telemetry_log_->set(c++, static_cast<int32_t>(msg.sdk));
+    telemetry_log_->set(c++, msg.pitch);
+    telemetry_log_->set(c++, msg.roll);
+    telemetry_log_->set(c++, msg.yaw);
+    telemetry_log_->set(c++, msg.vgx);
+    telemetry_log_->set(c++, msg.vgy);
+    telemetry_log_->set(c++, msg.vgz);
+    telemetry_log_->set(c++, msg.templ);
+    telemetry_log_->set(c++, msg.temph);
+    telemetry_log_->set(c++, msg.tof);
+    telemetry_log_->set(c++, msg.h);
+    telemetry_log_->set(c++, msg.bat);
+    telemetry_log_->set(c++, msg.baro);
+    telemetry_log_->set(c++, msg.time);
+    telemetry_log_->set(c++, msg.agx);
+    telemetry_log_->set(c++, msg.agy);
+    telemetry_log_->set(c++, msg.agz);
+    telemetry_log_->set(c++, msg.mid);
+    telemetry_log_->set(c++, msg.x);
+    telemetry_log_->set(c++, msg.y);
+    telemetry_log_->set(c++, msg.z);
+    telemetry_log_->end_sample();
+  }
+
+  // Called by the core state thread for each state packet, runs at 10Hz
+  void FlightDataPublisher::on_state(const std::string &raw, CoreClock::time_point time)
+  {
+    // Recorded raw, the black box parses only to check its triggers and when it dumps
+    if (driver_->black_box_) {
+      driver_->black_box_->on_state(raw, time);
+    }
+
+    bool subscribed = driver_->count_subscribers(driver_->flight_data_pub_->get_topic_name()) > 0;
+
+    if (!subscribed && !telemetry_log_ && !driver_->mission_executor_->running() && !driver_->controller_) {
+      // Nothing to do
+      return;
+    }
+
+    // Stamp with ROS time, so that messages follow use_sim_time
+    auto stamp = driver_->now();
+    bool publish = subscribed && driver_->flight_data_governor_.ready(stamp);
+
+    if (!publish && !telemetry_log_ && !driver_->mission_executor_->running() && !driver_->controller_) {
+      return;
+    }
+
+    auto fields = TelloCore::parse_fields(raw);
+
+    tello_msgs::msg::FlightData msg;
+    msg.header.stamp = stamp;
+    msg.raw = raw;
+
+    switch (driver_->core_->sdk()) {
+      case SdkVersion::v1_3:
+        msg.sdk = tello_msgs::msg::FlightData::SDK_1_3;
+        break;
+      case SdkVersion::v2_0:
+        msg.sdk = tello_msgs::msg::FlightData::SDK_2_0;
+        break;
+      default:
+        msg.sdk = tello_msgs::msg::FlightData::SDK_UNKNOWN;
+        break;
+    }
+
+    try {
+
+      if (msg.sdk == tello_msgs::msg::FlightData::SDK_2_0) {
+        msg.mid = std::stoi(fields["mid"]);
+        msg.x = std::stoi(fields["x"]);
+        msg.y = std::stoi(fields["y"]);
+        msg.z = std::stoi(fields["z"]);
+      }
+
+      msg.pitch = std::stoi(fields["pitch"]);
+      msg.roll = std::stoi(fields["roll"]);
+      msg.yaw = std::stoi(fields["yaw"]);
+      msg.vgx = std::stoi(fields["vgx"]);
+      msg.vgy = std::stoi(fields["vgy"]);
+      msg.vgz = std::stoi(fields["vgz"]);
+      msg.templ = std::stoi(fields["templ"]);
+      msg.temph = std::stoi(fields["temph"]);
+      msg.tof = std::stoi(fields["tof"]);
+      msg.h = std::stoi(fields["h"]);
+      msg.bat = std::stoi(fields["bat"]);
+      msg.baro = std::stof(fields["baro"]);
+      msg.time = std::stoi(fields["time"]);
+      msg.agx = std::stof(fields["agx"]);
+      msg.agy = std::stof(fields["agy"]);
+      msg.agz = std::stof(fields["agz"]);
+
+    } catch (std::exception &e) {
+      RCLCPP_ERROR(driver_->get_logger(), "Can't parse flight data");
+      return;
+    }
+
+    if (telemetry_log_) {
+      log_sample(msg);
+    }
+
+    // Check mission conditions as soon as the state arrives
+    driver_->mission_executor_->on_telemetry(fields, stamp);
+
+    // Run the controller on this sample, the setpoint is dropped if a command is in flight
+    // Plugin code may throw, unload the controller and hover rather than lose the state thread
+    if (driver_->controller_) {
+      RcSetpoint setpoint;
+      try {
+        if (driver_->controller_->update(msg, setpoint)) {
+          driver_->send_setpoint(setpoint);
+        }
+      } catch (std::exception &e) {
+        RCLCPP_ERROR(driver_->get_logger(), "Controller failed, unloading it, cmd_vel is back in charge: %s",
+                     e.what());
+        std::atomic_store(&driver_->controller_, std::shared_ptr<Controller>());
+        driver_->send_setpoint(RcSetpoint{});
+      }
+    }
+
+    // Only send ROS messages if there are subscribers
+    if (publish) {
+      driver_->flight_data_pub_->publish(msg);
+    }
+  }
+
+} // namespace tello_driver
@@ -0,0 +1,57 @@
+#include "frame_hub.hpp"
+
+namespace tello_driver
+{
+
+  FrameHub &FrameHub::instance()
+  {
+    static FrameHub hub;
+    return hub;
+  }
+
+  int FrameHub::add_listener(Listener listener)
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    int id = next_id_++;
+    listeners_.emplace(id, Entry{std::move(listener), false});
+    return id;
+  }
+
+  void FrameHub::remove_listener(int id)
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    listeners_.erase(id);
+    count_wanted();
+  }
+
+  void FrameHub::set_wanted(int id, bool wanted)
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto i = listeners_.find(id);
+    if (i != listeners_.end()) {
+      i->second.wanted = wanted;
+      count_wanted();
+    }
+  }
+
+  void FrameHub::count_wanted()
+  {
+    int count = 0;
+    for (const auto &listener : listeners_) {
+      count += listener.second.wanted ? 1 : 0;
+    }
+    wanted_count_ = count;
+  }
+
+  // Called by the video threads of all drivers in the process
+  void FrameHub::publish(const std::string &source, const AVFrame &frame)
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (const auto &listener : listeners_) {
+      if (listener.second.wanted) {
+        listener.second.listener(source, frame);
+      }
+    }
+  }
+
+} // namespace tello_driver
@@ -0,0 +1,215 @@
+#include "frame_ring.hpp"
+
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace tello_driver
+{
+
+  constexpr uint64_t RING_PAGE_SIZE = 4096;
+
+  static uint8_t *slot_base(uint8_t *base, uint64_t stride, uint64_t index)
+  {
+    return base + sizeof(FrameRingHeader) + index * stride;
+  }
+
+  static const uint8_t *slot_base(const uint8_t *base, uint64_t stride, uint64_t index)
+  {
+    return base + sizeof(FrameRingHeader) + index * stride;
+  }
+
+  static std::string shm_name(const std::string &name)
+  {
+    return name.empty() || name[0] != '/' ? "/" + name : name;
+  }
+
+  //=====================================================================================
+  // Writer
+  //=====================================================================================
+
+  FrameRingWriter::FrameRingWriter(const std::string &name, uint32_t num_slots, uint32_t slot_size) :
+    name_(shm_name(name))
+  {
+    if (num_slots < 2) {
+      throw std::runtime_error("frame ring needs at least 2 slots");
+    }
+
+    uint64_t stride = (sizeof(FrameSlotHeader) + slot_size + RING_PAGE_SIZE - 1) / RING_PAGE_SIZE * RING_PAGE_SIZE;
+    size_ = sizeof(FrameRingHeader) + num_slots * stride;
+
+    // Replace any existing ring, readers of the old ring will see that it is closed
+    shm_unlink(name_.c_str());
+    int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+      throw std::runtime_error("cannot create frame ring " + name_ + ": " + strerror(errno));
+    }
+
+    if (ftruncate(fd, static_cast<off_t>(size_)) < 0) {
+      close(fd);
+      shm_unlink(name_.c_str());
+      throw std::runtime_error("cannot size frame ring " + name_ + ": " + strerror(errno));
+    }
+
+    void *p = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+      shm_unlink(name_.c_str());
+      throw std::runtime_error("cannot map frame ring " + name_ + ": " + strerror(errno));
+    }
+
+    // ftruncate zero-fills, so all slots start with seq 0
+    base_ = static_cast<uint8_t *>(p);
+    header_ = reinterpret_cast<FrameRingHeader *>(base_);
+    header_->num_slots = num_slots;
+    header_->slot_size = slot_size;
+    header_->slot_stride = stride;
+    header_->frame_count.store(0, std::memory_order_relaxed);
+    header_->version = FRAME_RING_VERSION;
+    header_->state.store(FRAME_RING_OPEN, std::memory_order_relaxed);
+
+    // Readers check the magic last
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->magic = FRAME_RING_MAGIC;
+  }
+
+  FrameRingWriter::~FrameRingWriter()
+  {
+    header_->state.store(FRAME_RING_CLOSED, std::memory_order_release);
+    munmap(base_, size_);
+    shm_unlink(name_.c_str());
+  }
+
+  uint8_t *FrameRingWriter::begin_write()
+  {
+    // Already claimed, e.g., the previous write was abandoned
+    if (slot_) {
+      return reinterpret_cast<uint8_t *>(slot_) + sizeof(FrameSlotHeader);
+    }
+
+    uint64_t index = header_->frame_count.load(std::memory_order_relaxed) % header_->num_slots;
+    uint8_t *p = slot_base(base_, header_->slot_stride, index);
+    slot_ = reinterpret_cast<FrameSlotHeader *>(p);
+
+    // Odd seq tells readers to stay away, the fence keeps pixel writes after the seq write
+    slot_->seq.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    return p + sizeof(FrameSlotHeader);
+  }
+
+  void FrameRingWriter::end_write(uint32_t width, uint32_t height, uint32_t step, const std::string &encoding,
+                                  int64_t stamp_ns)
+  {
+    timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    uint64_t frame_number = header_->frame_count.load(std::memory_order_relaxed);
+    slot_->frame_number = frame_number;
+    slot_->stamp_ns = stamp_ns;
+    slot_->write_ns = static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    slot_->width = width;
+    slot_->height = height;
+    slot_->step = step;
+    strncpy(slot_->encoding, encoding.c_str(), sizeof(slot_->encoding) - 1);
+    slot_->encoding[sizeof(slot_->encoding) - 1] = '\0';
+
+    // Even seq publishes the slot, then frame_count points readers at it
+    slot_->seq.fetch_add(1, std::memory_order_release);
+    header_->frame_count.store(frame_number + 1, std::memory_order_release);
+    slot_ = nullptr;
+  }
+
+  //=====================================================================================
+  // Reader
+  //=====================================================================================
+
+  FrameRingReader::FrameRingReader(const std::string &name)
+  {
+    std::string full_name = shm_name(name);
+    int fd = shm_open(full_name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+      throw std::runtime_error("cannot open frame ring " + full_name + ": " + strerror(errno));
+    }
+
+    struct stat st{};
+    if (fstat(fd, &st) < 0 || st.st_size < static_cast<off_t>(sizeof(FrameRingHeader))) {
+      close(fd);
+      throw std::runtime_error("frame ring " + full_name + " is too small");
+    }
+
+    size_ = static_cast<size_t>(st.st_size);
+    void *p = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+      throw std::runtime_error("cannot map frame ring " + full_name + ": " + strerror(errno));
+    }
+
+    base_ = static_cast<const uint8_t *>(p);
+    header_ = reinterpret_cast<const FrameRingHeader *>(base_);
+
+    if (header_->magic != FRAME_RING_MAGIC || header_->version != FRAME_RING_VERSION ||
+        sizeof(FrameRingHeader) + header_->num_slots * header_->slot_stride > size_) {
+      munmap(const_cast<uint8_t *>(base_), size_);
+      throw std::runtime_error("frame ring " + full_name + " is not ready or has the wrong version");
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+  }
+
+  FrameRingReader::~FrameRingReader()
+  {
+    munmap(const_cast<uint8_t *>(base_), size_);
+  }
+
+  uint64_t FrameRingReader::frame_count() const
+  {
+    return header_->frame_count.load(std::memory_order_acquire);
+  }
+
+  bool FrameRingReader::closed() const
+  {
+    return header_->state.load(std::memory_order_acquire) != FRAME_RING_OPEN;
+  }
+
+  bool FrameRingReader::latest(FrameView &view) const
+  {
+    uint64_t count = header_->frame_count.load(std::memory_order_acquire);
+    if (count == 0) {
+      return false;
+    }
+
+    const uint8_t *p = slot_base(base_, header_->slot_stride, (count - 1) % header_->num_slots);
+    auto slot = reinterpret_cast<const FrameSlotHeader *>(p);
+
+    uint64_t seq = slot->seq.load(std::memory_order_acquire);
+    if (seq & 1) {
+      return false;
+    }
+
+    view.slot = slot;
+    view.seq = seq;
+    view.data = p + sizeof(FrameSlotHeader);
+    view.frame_number = slot->frame_number;
+    view.stamp_ns = slot->stamp_ns;
+    view.write_ns = slot->write_ns;
+    view.width = slot->width;
+    view.height = slot->height;
+    view.step = slot->step;
+    view.encoding.assign(slot->encoding, strnlen(slot->encoding, sizeof(slot->encoding)));
+
+    // The header fields must not be torn
+    return still_valid(view);
+  }
+
+  bool FrameRingReader::still_valid(const FrameView &view) const
+  {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return view.slot->seq.load(std::memory_order_relaxed) == view.seq;
+  }
+
+} // namespace tello_driver
@@ -0,0 +1,145 @@
+#include "marker_detector_node.hpp"
+
+#include <opencv2/imgproc.hpp>
+
+#include "ros2_shared/context_macros.hpp"
+#include "sensor_msgs/image_encodings.hpp"
+
+namespace tello_marker
+{
+
+#define MARKER_DETECTOR_ALL_PARAMS \
+  CXT_MACRO_MEMBER(               /* Marker side length in meters */ \
+  marker_length, \
+  double, 0.1778) \
+  CXT_MACRO_MEMBER(               /* ArUco dictionary, see cv::aruco::PREDEFINED_DICTIONARY_NAME */ \
+  dictionary, \
+  int, cv::aruco::DICT_6X6_250) \
+  CXT_MACRO_MEMBER(               /* Detect on an image this many times smaller, then refine, 1 to disable */ \
+  decimate, \
+  int, 2) \
+  /* End of list */
+
+  struct MarkerDetectorContext
+  {
+#undef CXT_MACRO_MEMBER
+#define CXT_MACRO_MEMBER(n, t, d) CXT_MACRO_DEFINE_MEMBER(n, t, d)
+    CXT_MACRO_DEFINE_MEMBERS(MARKER_DETECTOR_ALL_PARAMS)
+  };
+
+  MarkerDetectorNode::MarkerDetectorNode(const rclcpp::NodeOptions &options) :
+    Node("marker_detector", options)
+  {
+    using std::placeholders::_1;
+
+    // Parameters - Allocate the parameter context as a local variable because it is not used outside this routine
+    MarkerDetectorContext cxt{};
+#undef CXT_MACRO_MEMBER
+#define CXT_MACRO_MEMBER(n, t, d) CXT_MACRO_LOAD_PARAMETER((*this), cxt, n, t, d)
+    CXT_MACRO_INIT_PARAMETERS(MARKER_DETECTOR_ALL_PARAMS, [this]()
+    {})
+
+    marker_length_ = cxt.marker_length_;
+    decimate_ = std::max(1, cxt.decimate_);
+    dictionary_ = cv::aruco::getPredefinedDictionary(cxt.dictionary_);
+    detector_params_ = cv::aruco::DetectorParameters::create();
+
+    camera_info_sub_ = create_subscription<sensor_msgs::msg::CameraInfo>(
+      "camera_info", rclcpp::SensorDataQoS(), std::bind(&MarkerDetectorNode::camera_info_callback, this, _1));
+    image_sub_ = create_subscription<sensor_msgs::msg::Image>(
+      "image_gray", 1, std::bind(&MarkerDetectorNode::image_callback, this, _1));
+    marker_poses_pub_ = create_publisher<tello_msgs::msg::MarkerPoses>("marker_poses", 1);
+
+    RCLCPP_INFO(get_logger(), "Detecting %gm markers, decimate %d", marker_length_, decimate_);
+  }
+
+  MarkerDetectorNode::~MarkerDetectorNode()
+  {}
+
+  void MarkerDetectorNode::camera_info_callback(const sensor_msgs::msg::CameraInfo::SharedPtr msg)
+  {
+    if (!have_camera_info_) {
+      camera_matrix_ = cv::Matx33d{msg->k.data()};
+      dist_coeffs_ = msg->d;
+      have_camera_info_ = true;
+    }
+  }
+
+  // Detect markers, corners are in full resolution pixels
+  void MarkerDetectorNode::detect(const cv::Mat &gray, std::vector<int> &ids,
+                                  std::vector<std::vector<cv::Point2f>> &corners)
+  {
+    if (decimate_ == 1) {
+      cv::aruco::detectMarkers(gray, dictionary_, corners, ids, detector_params_);
+      return;
+    }
+
+    // Most of the detection cost is thresholding and contour finding, which scales with the number of pixels
+    cv::resize(gray, decimated_, cv::Size{}, 1.0 / decimate_, 1.0 / decimate_, cv::INTER_AREA);
+    cv::aruco::detectMarkers(decimated_, dictionary_, corners, ids, detector_params_);
+
+    // Scale the corners back up, pixel centers move by (decimate - 1) / 2, then refine on the full image
+    auto offset = static_cast<float>(decimate_ - 1) / 2;
+    for (auto &marker : corners) {
+      for (auto &corner : marker) {
+        corner = corner * static_cast<float>(decimate_) + cv::Point2f{offset, offset};
+      }
+      cv::cornerSubPix(gray, marker, cv::Size{decimate_ + 1, decimate_ + 1}, cv::Size{-1, -1},
+                       cv::TermCriteria{cv::TermCriteria::COUNT + cv::TermCriteria::EPS, 20, 0.01});
+    }
+  }
+
+  void MarkerDetectorNode::image_callback(sensor_msgs::msg::Image::UniquePtr msg)
+  {
+    if (!have_camera_info_) {
+      RCLCPP_WARN_ONCE(get_logger(), "Waiting for camera_info");
+      return;
+    }
+
+    if (msg->encoding != sensor_msgs::image_encodings::MONO8) {
+      RCLCPP_ERROR_ONCE(get_logger(), "Expected mono8, got %s", msg->encoding.c_str());
+      return;
+    }
+
+    // Wrap the message data, no copy
+    cv::Mat gray{static_cast<int>(msg->height), static_cast<int>(msg->width), CV_8UC1, msg->data.data(), msg->step};
+
+    std::vector<int> ids;
+    std::vector<std::vector<cv::Point2f>> corners;
+    detect(gray, ids, corners);
+
+    tello_msgs::msg::MarkerPoses marker_poses_msg;
+    marker_poses_msg.header = msg->header;
+
+    if (!ids.empty()) {
+      std::vector<cv::Vec3d> rvecs, tvecs;
+      cv::aruco::estimatePoseSingleMarkers(corners, marker_length_, camera_matrix_, dist_coeffs_, rvecs, tvecs);
+
+      for (size_t i = 0; i < ids.size(); ++i) {
+        // Rodrigues vector to quaternion
+        double angle = cv::norm(rvecs[i]);
+        cv::Vec3d axis = angle > 0 ? rvecs[i] / angle : cv::Vec3d{1, 0, 0};
+        double s = std::sin(angle / 2);
+
+        geometry_msgs::msg::Pose pose;
+        pose.position.x = tvecs[i][0];
+        pose.position.y = tvecs[i][1];
+        pose.position.z = tvecs[i][2];
+        pose.orientation.x = axis[0] * s;
+        pose.orientation.y = axis[1] * s;
+        pose.orientation.z = axis[2] * s;
+        pose.orientation.w = std::cos(angle / 2);
+
+        marker_poses_msg.ids.push_back(ids[i]);
+        marker_poses_msg.poses.push_back(pose);
+      }
+    }
+
+    marker_poses_pub_->publish(marker_poses_msg);
+  }
+
+} // namespace tello_marker
+
+#include "rclcpp_components/register_node_macro.hpp"
+
+RCLCPP_COMPONENTS_REGISTER_NODE(tello_marker::MarkerDetectorNode)
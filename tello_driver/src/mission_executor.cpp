@@ -0,0 +1,264 @@
+#include "tello_driver_node.hpp"
+
+namespace tello_driver
+{
+
+  using tello_msgs::msg::MissionStatus;
+  using tello_msgs::msg::MissionStep;
+
+  MissionExecutor::MissionExecutor(TelloDriverNode *driver, std::function<bool(const std::string &)> send) :
+    driver_(driver), send_(std::move(send))
+  {}
+
+  bool MissionExecutor::Condition::eval(const Fields &fields) const
+  {
+    auto i = fields.find(field);
+    if (i == fields.end()) {
+      return false;
+    }
+
+    double v;
+    try {
+      v = std::stod(i->second);
+    } catch (std::exception &e) {
+      return false;
+    }
+
+    switch (op) {
+      case MissionStep::LT:
+        return v < value;
+      case MissionStep::LE:
+        return v <= value;
+      case MissionStep::GT:
+        return v > value;
+      case MissionStep::GE:
+        return v >= value;
+      default:
+        return false;
+    }
+  }
+
+  bool MissionExecutor::start(const std::vector<MissionStep> &steps, const rclcpp::Time &now, std::string &error)
+  {
+    // Check everything before starting
+    std::vector<Step> checked;
+    for (size_t i = 0; i < steps.size(); ++i) {
+      const auto &step = steps[i];
+      Step s{step.type, "", Condition{step.field, step.op, step.value}, step.timeout};
+      std::string why;
+
+      if (step.type == MissionStep::COMMAND || step.type == MissionStep::WATCH) {
+        if (!encode_command(step.command, s.text, why)) {
+          error = "step " + std::to_string(i) + ": " + why;
+          return false;
+        }
+      } else if (step.type != MissionStep::WAIT && step.type != MissionStep::WAIT_UNTIL) {
+        error = "step " + std::to_string(i) + ": unknown step type " + std::to_string(step.type);
+        return false;
+      }
+
+      if ((step.type == MissionStep::WAIT_UNTIL || step.type == MissionStep::WATCH) &&
+          (step.field.empty() || step.op < MissionStep::LT || step.op > MissionStep::GE)) {
+        error = "step " + std::to_string(i) + ": condition needs a field and an op";
+        return false;
+      }
+
+      if (step.timeout < 0) {
+        error = "step " + std::to_string(i) + ": negative timeout";
+        return false;
+      }
+
+      checked.push_back(s);
+    }
+
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    if (running_) {
+      error = "a mission is already running";
+      return false;
+    }
+
+    steps_ = std::move(checked);
+    next_ = 0;
+    phase_ = Phase::ready;
+    watches_.clear();
+    aborting_ = false;
+    running_ = true;
+
+    RCLCPP_INFO(driver_->get_logger(), "Starting mission with %zu steps", steps_.size());
+    advance(now, nullptr);
+    return true;
+  }
+
+  void MissionExecutor::cancel(const rclcpp::Time &now)
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    if (running_) {
+      finish(MissionStatus::CANCELED, now, "canceled");
+    }
+  }
+
+  void MissionExecutor::on_response(uint8_t rc, const std::string &str, const rclcpp::Time &now)
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    if (!running_) {
+      return;
+    }
+
+    if (phase_ == Phase::waiting_response) {
+      if (rc != tello_msgs::msg::TelloResponse::OK && !aborting_) {
+        finish(MissionStatus::FAILED, now, "'" + text_ + "' failed: " + str);
+        return;
+      }
+      phase_ = Phase::ready;
+    }
+
+    // Also retries a send that found the command socket busy
+    advance(now, nullptr);
+  }
+
+  void MissionExecutor::on_telemetry(const Fields &fields, const rclcpp::Time &now)
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    if (!running_) {
+      return;
+    }
+
+    // Watches pre-empt everything, including a command in flight
+    if (!aborting_) {
+      for (const auto &watch : watches_) {
+        if (watch.condition.eval(fields)) {
+          RCLCPP_WARN(driver_->get_logger(), "Mission watch %s fired, sending '%s'",
+                      watch.condition.field.c_str(), watch.text.c_str());
+          aborting_ = true;
+          steps_.clear();
+          next_ = 0;
+          text_ = watch.text;
+          phase_ = Phase::sending;
+          watches_.clear();
+          break;
+        }
+      }
+    }
+
+    advance(now, &fields);
+  }
+
+  void MissionExecutor::on_tick(const rclcpp::Time &now)
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    if (running_) {
+      advance(now, nullptr);
+    }
+  }
+
+  void MissionExecutor::on_telemetry_lost(const rclcpp::Time &now)
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    if (running_) {
+      finish(MissionStatus::FAILED, now, "lost telemetry");
+    }
+  }
+
+  // Run steps until one has to wait, mtx_ must be held
+  void MissionExecutor::advance(const rclcpp::Time &now, const Fields *fields)
+  {
+    while (running_) {
+      switch (phase_) {
+        case Phase::sending:
+          if (!send_(text_)) {
+            // Busy, try again on the next response, state packet or tick
+            return;
+          }
+          // The drone doesn't respond to rc
+          phase_ = text_.rfind("rc", 0) == 0 ? Phase::ready : Phase::waiting_response;
+          break;
+
+        case Phase::waiting_response:
+          return;
+
+        case Phase::waiting_time:
+          if (now < deadline_) {
+            return;
+          }
+          phase_ = Phase::ready;
+          break;
+
+        case Phase::waiting_condition:
+          if (fields && condition_.eval(*fields)) {
+            phase_ = Phase::ready;
+            break;
+          }
+          if (deadline_.nanoseconds() > 0 && now >= deadline_) {
+            finish(MissionStatus::FAILED, now, "timed out waiting for " + condition_.field);
+          }
+          return;
+
+        case Phase::ready: {
+          if (next_ >= steps_.size()) {
+            finish(aborting_ ? MissionStatus::ABORTED : MissionStatus::SUCCEEDED, now, "");
+            return;
+          }
+
+          const Step &step = steps_[next_++];
+          publish_status(MissionStatus::RUNNING, now, "");
+
+          switch (step.type) {
+            case MissionStep::COMMAND:
+              text_ = step.text;
+              phase_ = Phase::sending;
+              break;
+
+            case MissionStep::WAIT:
+              deadline_ = now + rclcpp::Duration::from_seconds(step.timeout);
+              phase_ = Phase::waiting_time;
+              break;
+
+            case MissionStep::WAIT_UNTIL:
+              condition_ = step.condition;
+              deadline_ = step.timeout > 0 ? now + rclcpp::Duration::from_seconds(step.timeout) :
+                          rclcpp::Time(0, 0, now.get_clock_type());
+              phase_ = Phase::waiting_condition;
+              break;
+
+            case MissionStep::WATCH:
+              watches_.push_back(Watch{step.condition, step.text});
+              break;
+          }
+          break;
+        }
+      }
+    }
+  }
+
+  void MissionExecutor::finish(uint8_t state, const rclcpp::Time &now, const std::string &str)
+  {
+    running_ = false;
+    phase_ = Phase::ready;
+    steps_.clear();
+    watches_.clear();
+
+    if (state == MissionStatus::SUCCEEDED) {
+      RCLCPP_INFO(driver_->get_logger(), "Mission succeeded");
+    } else {
+      RCLCPP_WARN(driver_->get_logger(), "Mission ended, state %d %s", state, str.c_str());
+    }
+    publish_status(state, now, str);
+  }
+
+  void MissionExecutor::publish_status(uint8_t state, const rclcpp::Time &now, const std::string &str)
+  {
+    MissionStatus msg;
+    msg.header.stamp = now;
+    msg.state = state;
+    msg.step = static_cast<int32_t>(next_) - 1;
+    msg.str = str;
+    driver_->mission_status_pub_->publish(msg);
+  }
+
+} // namespace tello_driver
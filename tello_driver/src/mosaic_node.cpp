@@ -0,0 +1,219 @@
+#include "mosaic_node.hpp"
+
+#include <algorithm>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libswscale/swscale.h>
+}
+
+#include "frame_hub.hpp"
+#include "ros2_shared/context_macros.hpp"
+#include "sensor_msgs/image_encodings.hpp"
+
+namespace tello_mosaic
+{
+
+#define MOSAIC_ALL_PARAMS \
+  CXT_MACRO_MEMBER(               /* Fully qualified driver names in tile order, empty for first come, first served */ \
+  sources, \
+  std::vector<std::string>, std::vector<std::string>{}) \
+  CXT_MACRO_MEMBER(               /* Tiles across */ \
+  columns, \
+  int, 2) \
+  CXT_MACRO_MEMBER(               /* Tiles down */ \
+  rows, \
+  int, 2) \
+  CXT_MACRO_MEMBER(               /* Tile width in pixels, frames are scaled to fit */ \
+  tile_width, \
+  int, 320) \
+  CXT_MACRO_MEMBER(               /* Tile height in pixels */ \
+  tile_height, \
+  int, 240) \
+  CXT_MACRO_MEMBER(               /* Publish at most this many times a second */ \
+  max_rate, \
+  double, 10.0) \
+  /* End of list */
+
+  struct MosaicContext
+  {
+#undef CXT_MACRO_MEMBER
+#define CXT_MACRO_MEMBER(n, t, d) CXT_MACRO_DEFINE_MEMBER(n, t, d)
+    CXT_MACRO_DEFINE_MEMBERS(MOSAIC_ALL_PARAMS)
+  };
+
+  MosaicNode::MosaicNode(const rclcpp::NodeOptions &options) :
+    Node("mosaic", options),
+    scratch_(av_frame_alloc())
+  {
+    // Parameters - Allocate the parameter context as a local variable because it is not used outside this routine
+    MosaicContext cxt{};
+#undef CXT_MACRO_MEMBER
+#define CXT_MACRO_MEMBER(n, t, d) CXT_MACRO_LOAD_PARAMETER((*this), cxt, n, t, d)
+    CXT_MACRO_INIT_PARAMETERS(MOSAIC_ALL_PARAMS, [this]()
+    {})
+
+    int columns = std::max(1, cxt.columns_);
+    int rows = std::max(1, cxt.rows_);
+
+    // Even sizes keep the chroma planes aligned with the tiles
+    tile_width_ = std::max(2, cxt.tile_width_ & ~1);
+    tile_height_ = std::max(2, cxt.tile_height_ & ~1);
+    width_ = columns * tile_width_;
+    height_ = rows * tile_height_;
+    assign_on_arrival_ = cxt.sources_.empty();
+
+    if (cxt.sources_.size() > static_cast<size_t>(columns * rows)) {
+      RCLCPP_WARN(get_logger(), "%d sources, but only %d tiles", static_cast<int>(cxt.sources_.size()),
+                  columns * rows);
+    }
+
+    for (int i = 0; i < columns * rows; ++i) {
+      auto tile = std::make_unique<Tile>();
+      tile->source = i < static_cast<int>(cxt.sources_.size()) ? cxt.sources_[i] : "";
+      tile->x = (i % columns) * tile_width_;
+      tile->y = (i / columns) * tile_height_;
+      tile->frame = av_frame_alloc();
+      tiles_.push_back(std::move(tile));
+    }
+
+    // Empty tiles are black
+    composite_.resize(static_cast<size_t>(width_) * height_ * 3);
+
+    image_pub_ = create_publisher<sensor_msgs::msg::Image>("image_raw", 1);
+
+    auto period = std::chrono::duration<double>(1.0 / std::max(0.1, cxt.max_rate_));
+    timer_ = create_wall_timer(std::chrono::duration_cast<std::chrono::nanoseconds>(period),
+                               std::bind(&MosaicNode::timer_callback, this));
+
+    // Frames arrive once the timer sees a subscriber
+    listener_id_ = tello_driver::FrameHub::instance().add_listener(
+      [this](const std::string &source, const AVFrame &frame)
+      {
+        on_frame(source, frame);
+      });
+
+    RCLCPP_INFO(get_logger(), "Mosaic of %dx%d tiles, %dx%d pixels, at most %gHz", columns, rows, width_, height_,
+                cxt.max_rate_);
+  }
+
+  MosaicNode::~MosaicNode()
+  {
+    // Waits for calls in progress, no more frames after this
+    tello_driver::FrameHub::instance().remove_listener(listener_id_);
+
+    for (auto &tile : tiles_) {
+      av_frame_free(&tile->frame);
+      sws_freeContext(tile->sws);
+    }
+    av_frame_free(&scratch_);
+  }
+
+  // Only swaps a reference, the video thread never waits for pixel work
+  void MosaicNode::on_frame(const std::string &source, const AVFrame &frame)
+  {
+    // Calls are serialized by the FrameHub, but the timer reads source too, so hold the tile's lock
+    for (auto &tile : tiles_) {
+      std::lock_guard<std::mutex> lock(tile->mtx);
+      if (tile->source == source) {
+        av_frame_unref(tile->frame);
+        av_frame_ref(tile->frame, &frame);
+        tile->dirty = true;
+        return;
+      }
+    }
+
+    if (!assign_on_arrival_) {
+      return;
+    }
+
+    for (auto &tile : tiles_) {
+      std::lock_guard<std::mutex> lock(tile->mtx);
+      if (tile->source.empty()) {
+        tile->source = source;
+        av_frame_ref(tile->frame, &frame);
+        tile->dirty = true;
+        RCLCPP_INFO(get_logger(), "Tile at (%d, %d) shows %s", tile->x, tile->y, source.c_str());
+        return;
+      }
+    }
+  }
+
+  bool MosaicNode::draw(Tile &tile, const AVFrame &frame, const std::string &source)
+  {
+    tile.sws = sws_getCachedContext(tile.sws, frame.width, frame.height, static_cast<AVPixelFormat>(frame.format),
+                                    tile_width_, tile_height_, AV_PIX_FMT_BGR24, SWS_BILINEAR,
+                                    nullptr, nullptr, nullptr);
+    if (!tile.sws) {
+      RCLCPP_ERROR(get_logger(), "Can't scale %dx%d frames from %s", frame.width, frame.height, source.c_str());
+      return false;
+    }
+
+    // Write the tile's rows in place, the stride is the composite's
+    uint8_t *dst[] = {composite_.data() + (static_cast<size_t>(tile.y) * width_ + tile.x) * 3};
+    int dst_stride[] = {width_ * 3};
+    sws_scale(tile.sws, frame.data, frame.linesize, 0, frame.height, dst, dst_stride);
+    return true;
+  }
+
+  void MosaicNode::timer_callback()
+  {
+    // Drivers skip the hub entirely while nobody watches the mosaic
+    bool subscribed = count_subscribers(image_pub_->get_topic_name()) > 0;
+    if (subscribed != wanted_) {
+      tello_driver::FrameHub::instance().set_wanted(listener_id_, subscribed);
+      wanted_ = subscribed;
+
+      // Don't hold on to decoder buffers while nobody is watching
+      if (!subscribed) {
+        for (auto &tile : tiles_) {
+          std::lock_guard<std::mutex> lock(tile->mtx);
+          av_frame_unref(tile->frame);
+          tile->dirty = false;
+        }
+      }
+    }
+
+    if (!subscribed) {
+      return;
+    }
+
+    bool changed = false;
+
+    for (auto &tile : tiles_) {
+      std::string source;
+      {
+        std::lock_guard<std::mutex> lock(tile->mtx);
+        if (!tile->dirty) {
+          continue;
+        }
+        av_frame_move_ref(scratch_, tile->frame);
+        tile->dirty = false;
+        source = tile->source;
+      }
+
+      changed |= draw(*tile, *scratch_, source);
+      av_frame_unref(scratch_);
+    }
+
+    if (!changed) {
+      return;
+    }
+
+    // Publish a unique_ptr so intra-process subscribers take ownership
+    auto msg = std::make_unique<sensor_msgs::msg::Image>();
+    msg->header.frame_id = "mosaic";
+    msg->header.stamp = now();
+    msg->height = height_;
+    msg->width = width_;
+    msg->encoding = sensor_msgs::image_encodings::BGR8;
+    msg->step = width_ * 3;
+    msg->data = composite_;
+    image_pub_->publish(std::move(msg));
+  }
+
+} // namespace tello_mosaic
+
+#include "rclcpp_components/register_node_macro.hpp"
+
+RCLCPP_COMPONENTS_REGISTER_NODE(tello_mosaic::MosaicNode)
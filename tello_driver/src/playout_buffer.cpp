@@ -0,0 +1,172 @@
+#include "playout_buffer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+namespace tello_driver
+{
+
+  constexpr double DEFAULT_INTERVAL = 1.0 / 30;     // Tello streams at 30fps until we know better
+  constexpr double MAX_GAP = 1.0;                   // Longer gaps aren't jitter, the stream stopped
+  constexpr double INTERVAL_GAIN = 1.0 / 64;        // Mean inter-arrival time moves slowly
+  constexpr double JITTER_GAIN = 1.0 / 16;          // As in RFC 3550
+  constexpr double JITTER_MULTIPLE = 3;             // Target delay covers this many times the jitter
+  constexpr double MAX_STRETCH = 0.1;               // Change the release interval by at most 10%
+  constexpr double STEER_HORIZON = 0.1;             // Delay error that gives the full stretch, in seconds
+
+  PlayoutBuffer::PlayoutBuffer(const Config &config, Release release) :
+    config_(config),
+    release_(std::move(release)),
+    interval_(DEFAULT_INTERVAL),
+    target_delay_(config.min_delay)
+  {
+    thread_ = std::thread(&PlayoutBuffer::run, this);
+  }
+
+  PlayoutBuffer::~PlayoutBuffer()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      stopping_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+
+    while (!entries_.empty()) {
+      drop_front();
+    }
+  }
+
+  void PlayoutBuffer::push(const AVFrame &frame, Clock::time_point arrival)
+  {
+    // Shares the decoder's reference counted buffers, no pixels are copied
+    AVFrame *ref = av_frame_clone(&frame);
+    if (!ref) {
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+
+      stats_.frames_in++;
+
+      // A frame arriving after an empty slot missed that slot
+      if (owed_ > 0) {
+        owed_--;
+        stats_.late++;
+      }
+
+      // Several frames decoded from one sequence arrive together, that's jitter too
+      if (last_arrival_ != Clock::time_point{}) {
+        double gap = std::chrono::duration<double>(arrival - last_arrival_).count();
+        if (gap < MAX_GAP) {
+          interval_ += (gap - interval_) * INTERVAL_GAIN;
+          jitter_ += (std::abs(gap - interval_) - jitter_) * JITTER_GAIN;
+        }
+      }
+      last_arrival_ = arrival;
+
+      if (config_.adaptive) {
+        target_delay_ = std::max(config_.min_delay, std::min(config_.max_delay, JITTER_MULTIPLE * jitter_));
+      }
+
+      entries_.push_back(Entry{ref, arrival});
+    }
+
+    cv_.notify_all();
+  }
+
+  PlayoutStats PlayoutBuffer::take_stats()
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    PlayoutStats stats = stats_;
+    stats.target_delay = target_delay_;
+    stats.interval = interval_;
+    stats.buffered = static_cast<int>(entries_.size());
+    stats_ = PlayoutStats{};
+    return stats;
+  }
+
+  // mtx_ must be held
+  void PlayoutBuffer::drop_front()
+  {
+    av_frame_free(&entries_.front().frame);
+    entries_.pop_front();
+  }
+
+  void PlayoutBuffer::run()
+  {
+    using std::chrono::duration;
+    using std::chrono::duration_cast;
+
+    std::unique_lock<std::mutex> lock(mtx_);
+    Clock::time_point next{};           // Next release slot
+
+    while (!stopping_) {
+      if (priming_) {
+        // Wait for a frame, then hold it for the target delay
+        cv_.wait(lock, [this]() { return stopping_ || !entries_.empty(); });
+        if (stopping_) {
+          break;
+        }
+
+        next = entries_.front().arrival + duration_cast<Clock::duration>(duration<double>(target_delay_));
+        priming_ = false;
+        owed_ = 0;
+      }
+
+      // Sleep until the slot, absolute deadlines keep the cadence from drifting
+      if (cv_.wait_until(lock, next, [this]() { return stopping_; })) {
+        break;
+      }
+
+      auto now = Clock::now();
+
+      if (entries_.empty()) {
+        stats_.underruns++;
+        owed_++;
+
+        // The stream stopped, start over when it resumes
+        if (owed_ * interval_ > config_.max_delay) {
+          priming_ = true;
+        } else {
+          next += duration_cast<Clock::duration>(duration<double>(interval_));
+        }
+        continue;
+      }
+
+      // Don't let a burst build an unbounded delay
+      while (entries_.size() > 1 &&
+             duration<double>(now - entries_.front().arrival).count() > config_.max_delay) {
+        drop_front();
+        stats_.dropped++;
+      }
+
+      Entry entry = entries_.front();
+      entries_.pop_front();
+
+      // Steer toward the target delay: release more slowly if the delay is too short, faster if it's too long
+      double error = target_delay_ - duration<double>(now - entry.arrival).count();
+      double stretch = std::max(-MAX_STRETCH, std::min(MAX_STRETCH, MAX_STRETCH * error / STEER_HORIZON));
+      next += duration_cast<Clock::duration>(duration<double>(interval_ * (1 + stretch)));
+
+      // Fell behind, e.g., a slow subscriber, resume from now instead of bursting to catch up
+      if (next < now) {
+        next = now;
+      }
+
+      stats_.frames_out++;
+
+      // Outside the lock, so push() doesn't wait for the release
+      lock.unlock();
+      release_(*entry.frame, entry.arrival);
+      av_frame_free(&entry.frame);
+      lock.lock();
+    }
+  }
+
+} // namespace tello_driver
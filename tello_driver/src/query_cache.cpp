@@ -0,0 +1,81 @@
+#include "tello_driver_node.hpp"
+
+namespace tello_driver
+{
+
+  // Stop refreshing a query if no ROS client has asked for it in this many TTLs
+  constexpr int64_t FORGET_TTLS = 10;
+
+  bool QueryCache::is_query(const std::string &command)
+  {
+    return !command.empty() && command.back() == '?';
+  }
+
+  void QueryCache::store(const std::string &query, const std::string &value, const rclcpp::Time &now)
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    auto &entry = entries_[query];
+    entry.value = value;
+    entry.answer_time = now;
+    entry.stale = false;
+  }
+
+  bool QueryCache::request(const std::string &query, const rclcpp::Time &now, Entry &entry)
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    auto i = entries_.find(query);
+    if (i == entries_.end()) {
+      i = entries_.emplace(query, Entry{"", rclcpp::Time(0L, now.get_clock_type()), now}).first;
+    } else {
+      i->second.request_time = now;
+    }
+
+    entry = i->second;
+    return !entry.value.empty();
+  }
+
+  void QueryCache::mark_stale(const std::string &query)
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    auto i = entries_.find(query);
+    if (i != entries_.end()) {
+      i->second.stale = true;
+    }
+  }
+
+  bool QueryCache::next_refresh(const rclcpp::Time &now, const rclcpp::Duration &ttl, std::string &query)
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    bool found = false;
+    rclcpp::Duration oldest = ttl;
+
+    for (auto &i : entries_) {
+      const Entry &entry = i.second;
+
+      // Only poll for answers that someone has been asking for
+      if (entry.request_time.nanoseconds() == 0 || now - entry.request_time > ttl * FORGET_TTLS) {
+        continue;
+      }
+
+      // Missing answers and answers a client found too old go first, then the stalest answer
+      if (entry.value.empty() || entry.stale) {
+        query = i.first;
+        return true;
+      }
+
+      auto age = now - entry.answer_time;
+      if (age >= oldest) {
+        oldest = age;
+        query = i.first;
+        found = true;
+      }
+    }
+
+    return found;
+  }
+
+} // namespace tello_driver
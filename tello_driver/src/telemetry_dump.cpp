@@ -0,0 +1,58 @@
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+
+#include "telemetry_log.hpp"
+
+//=====================================================================================
+// Dump a columnar telemetry log as CSV
+//
+// Usage: telemetry_dump log_file [column ...]
+//=====================================================================================
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2) {
+    std::cerr << "usage: telemetry_dump log_file [column ...]" << std::endl;
+    return 1;
+  }
+
+  try {
+    tello_driver::TelemetryLogReader reader(argv[1]);
+
+    std::vector<size_t> indexes;
+    if (argc == 2) {
+      for (size_t i = 0; i < reader.columns().size(); ++i) {
+        indexes.push_back(i);
+      }
+    } else {
+      for (int i = 2; i < argc; ++i) {
+        indexes.push_back(reader.column_index(argv[i]));
+      }
+    }
+
+    std::vector<std::vector<double>> columns;
+    size_t rows = SIZE_MAX;
+    for (size_t i = 0; i < indexes.size(); ++i) {
+      columns.push_back(reader.column_as_double(indexes[i]));
+      rows = std::min(rows, columns.back().size());
+      std::cout << (i ? "," : "") << reader.columns()[indexes[i]].name;
+    }
+    std::cout << std::endl;
+
+    std::cout << std::setprecision(15);
+    for (size_t row = 0; row < rows; ++row) {
+      for (size_t i = 0; i < columns.size(); ++i) {
+        std::cout << (i ? "," : "") << columns[i][row];
+      }
+      std::cout << "\n";
+    }
+  }
+  catch (std::exception &e) {
+    std::cerr << "Exception: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,254 @@
+#include "telemetry_log.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace tello_driver
+{
+
+  constexpr uint64_t HEADER_SIZE = 4096;
+  constexpr uint64_t COLUMNS_OFFSET = 64;
+  constexpr uint64_t COLUMN_SIZE = 32;
+  constexpr uint64_t COLUMN_NAME_SIZE = 24;
+  constexpr uint64_t CHUNK_HEADER_SIZE = 64;
+  constexpr uint64_t MAX_COLUMNS = (HEADER_SIZE - COLUMNS_OFFSET) / COLUMN_SIZE;
+
+  template<typename T>
+  static T &field(uint8_t *base, uint64_t offset)
+  {
+    return *reinterpret_cast<T *>(base + offset);
+  }
+
+  template<typename T>
+  static const T &field(const uint8_t *base, uint64_t offset)
+  {
+    return *reinterpret_cast<const T *>(base + offset);
+  }
+
+  size_t TelemetryLogReader::type_size(TelemetryType type)
+  {
+    switch (type) {
+      case TelemetryType::INT32:
+      case TelemetryType::FLOAT32:
+        return 4;
+      case TelemetryType::INT64:
+      case TelemetryType::FLOAT64:
+        return 8;
+    }
+    throw std::invalid_argument("unknown column type");
+  }
+
+  //=====================================================================================
+  // Writer
+  //=====================================================================================
+
+  TelemetryLogWriter::TelemetryLogWriter(const std::string &path, const std::vector<TelemetryColumn> &columns,
+                                         uint32_t chunk_capacity) :
+    chunk_capacity_(chunk_capacity)
+  {
+    if (columns.empty() || columns.size() > MAX_COLUMNS || chunk_capacity == 0) {
+      throw std::invalid_argument("bad telemetry log layout");
+    }
+
+    // Lay out the column arrays, each 64-byte aligned
+    uint64_t offset = CHUNK_HEADER_SIZE;
+    for (auto &column : columns) {
+      offsets_.push_back(static_cast<uint32_t>(offset));
+      offset += (TelemetryLogReader::type_size(column.type) * chunk_capacity + 63) / 64 * 64;
+    }
+    chunk_size_ = (offset + HEADER_SIZE - 1) / HEADER_SIZE * HEADER_SIZE;
+
+    fd_ = open(path.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0644);
+    if (fd_ < 0) {
+      throw std::runtime_error("cannot create telemetry log " + path + ": " + strerror(errno));
+    }
+
+    if (ftruncate(fd_, static_cast<off_t>(HEADER_SIZE)) < 0) {
+      close(fd_);
+      throw std::runtime_error("cannot size telemetry log " + path + ": " + strerror(errno));
+    }
+
+    void *p = mmap(nullptr, HEADER_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (p == MAP_FAILED) {
+      close(fd_);
+      throw std::runtime_error("cannot map telemetry log " + path + ": " + strerror(errno));
+    }
+    header_ = static_cast<uint8_t *>(p);
+
+    field<uint32_t>(header_, 4) = TELEMETRY_LOG_VERSION;
+    field<uint32_t>(header_, 8) = static_cast<uint32_t>(columns.size());
+    field<uint32_t>(header_, 12) = chunk_capacity_;
+    field<uint64_t>(header_, 16) = chunk_size_;
+    field<uint64_t>(header_, 24) = 0;
+    for (size_t i = 0; i < columns.size(); ++i) {
+      uint8_t *column = header_ + COLUMNS_OFFSET + i * COLUMN_SIZE;
+      strncpy(reinterpret_cast<char *>(column), columns[i].name.c_str(), COLUMN_NAME_SIZE - 1);
+      field<uint32_t>(column, 24) = static_cast<uint32_t>(columns[i].type);
+      field<uint32_t>(column, 28) = offsets_[i];
+    }
+    field<uint32_t>(header_, 0) = TELEMETRY_LOG_MAGIC;
+
+    map_chunk(0);
+  }
+
+  TelemetryLogWriter::~TelemetryLogWriter()
+  {
+    munmap(chunk_, chunk_size_);
+    munmap(header_, HEADER_SIZE);
+    close(fd_);
+  }
+
+  void TelemetryLogWriter::map_chunk(uint64_t index)
+  {
+    if (chunk_) {
+      munmap(chunk_, chunk_size_);
+      chunk_ = nullptr;
+    }
+
+    // ftruncate zero-fills, so the new chunk starts with count 0
+    off_t offset = static_cast<off_t>(HEADER_SIZE + index * chunk_size_);
+    if (ftruncate(fd_, offset + static_cast<off_t>(chunk_size_)) < 0) {
+      throw std::runtime_error(std::string("cannot grow telemetry log: ") + strerror(errno));
+    }
+
+    void *p = mmap(nullptr, chunk_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, offset);
+    if (p == MAP_FAILED) {
+      throw std::runtime_error(std::string("cannot map telemetry log chunk: ") + strerror(errno));
+    }
+
+    chunk_ = static_cast<uint8_t *>(p);
+    chunk_index_ = index;
+    row_ = 0;
+    field<uint64_t>(header_, 24) = index + 1;
+  }
+
+  void TelemetryLogWriter::begin_sample()
+  {
+    if (row_ == chunk_capacity_) {
+      map_chunk(chunk_index_ + 1);
+    }
+  }
+
+  void TelemetryLogWriter::end_sample()
+  {
+    field<uint64_t>(chunk_, 0) = ++row_;
+  }
+
+  //=====================================================================================
+  // Reader
+  //=====================================================================================
+
+  TelemetryLogReader::TelemetryLogReader(const std::string &path)
+  {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("cannot open telemetry log " + path + ": " + strerror(errno));
+    }
+
+    struct stat st{};
+    if (fstat(fd, &st) < 0 || st.st_size < static_cast<off_t>(HEADER_SIZE)) {
+      close(fd);
+      throw std::runtime_error("telemetry log " + path + " is too small");
+    }
+
+    size_ = static_cast<size_t>(st.st_size);
+    void *p = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+      throw std::runtime_error("cannot map telemetry log " + path + ": " + strerror(errno));
+    }
+    base_ = static_cast<const uint8_t *>(p);
+
+    if (field<uint32_t>(base_, 0) != TELEMETRY_LOG_MAGIC || field<uint32_t>(base_, 4) != TELEMETRY_LOG_VERSION) {
+      munmap(const_cast<uint8_t *>(base_), size_);
+      throw std::runtime_error(path + " is not a telemetry log, or has the wrong version");
+    }
+
+    uint32_t num_columns = field<uint32_t>(base_, 8);
+    chunk_size_ = field<uint64_t>(base_, 16);
+    if (chunk_size_ == 0) {
+      munmap(const_cast<uint8_t *>(base_), size_);
+      throw std::runtime_error(path + " has a corrupt header, chunk size is 0");
+    }
+
+    // The writer may still be appending, only look at chunks that were mapped
+    num_chunks_ = std::min(field<uint64_t>(base_, 24), (size_ - HEADER_SIZE) / chunk_size_);
+
+    for (uint32_t i = 0; i < num_columns && i < MAX_COLUMNS; ++i) {
+      const uint8_t *column = base_ + COLUMNS_OFFSET + i * COLUMN_SIZE;
+      columns_.push_back(TelemetryColumn{
+        std::string(reinterpret_cast<const char *>(column), strnlen(reinterpret_cast<const char *>(column),
+                                                                   COLUMN_NAME_SIZE)),
+        static_cast<TelemetryType>(field<uint32_t>(column, 24))});
+      offsets_.push_back(field<uint32_t>(column, 28));
+    }
+  }
+
+  TelemetryLogReader::~TelemetryLogReader()
+  {
+    munmap(const_cast<uint8_t *>(base_), size_);
+  }
+
+  size_t TelemetryLogReader::column_index(const std::string &name) const
+  {
+    for (size_t i = 0; i < columns_.size(); ++i) {
+      if (columns_[i].name == name) {
+        return i;
+      }
+    }
+    throw std::out_of_range("no column " + name);
+  }
+
+  uint64_t TelemetryLogReader::num_samples() const
+  {
+    uint64_t total = 0;
+    for (uint64_t i = 0; i < num_chunks_; ++i) {
+      total += field<uint64_t>(base_, HEADER_SIZE + i * chunk_size_);
+    }
+    return total;
+  }
+
+  uint64_t TelemetryLogReader::copy_column(size_t index, void *out, uint64_t max_samples) const
+  {
+    size_t element = type_size(columns_[index].type);
+    auto dst = static_cast<uint8_t *>(out);
+    uint64_t total = 0;
+
+    // The writer may have added samples since num_samples() was called, stop at max_samples
+    for (uint64_t i = 0; i < num_chunks_ && total < max_samples; ++i) {
+      const uint8_t *chunk = base_ + HEADER_SIZE + i * chunk_size_;
+      uint64_t count = std::min(field<uint64_t>(chunk, 0), max_samples - total);
+      total += count;
+      memcpy(dst, chunk + offsets_[index], count * element);
+      dst += count * element;
+    }
+    return total;
+  }
+
+  std::vector<double> TelemetryLogReader::column_as_double(size_t index) const
+  {
+    switch (columns_[index].type) {
+      case TelemetryType::INT32: {
+        auto values = column<int32_t>(columns_[index].name);
+        return std::vector<double>(values.begin(), values.end());
+      }
+      case TelemetryType::INT64: {
+        auto values = column<int64_t>(columns_[index].name);
+        return std::vector<double>(values.begin(), values.end());
+      }
+      case TelemetryType::FLOAT32: {
+        auto values = column<float>(columns_[index].name);
+        return std::vector<double>(values.begin(), values.end());
+      }
+      case TelemetryType::FLOAT64:
+        return column<double>(columns_[index].name);
+    }
+    throw std::invalid_argument("unknown column type");
+  }
+
+} // namespace tello_driver
@@ -0,0 +1,146 @@
+#include "tello_command.hpp"
+
+#include <cstdlib>
+#include <initializer_list>
+
+namespace tello_driver
+{
+
+  using tello_msgs::msg::TelloCommand;
+
+  // SDK ranges
+  constexpr int MIN_DISTANCE = 20;
+  constexpr int MAX_DISTANCE = 500;
+  constexpr int MIN_ANGLE = 1;
+  constexpr int MAX_ANGLE = 3600;
+  constexpr int MIN_SPEED = 10;
+  constexpr int MAX_SPEED = 100;
+  constexpr int MAX_CURVE_SPEED = 60;
+  constexpr int MAX_COORD = 500;
+  constexpr int MIN_COORD = 20;           // go and curve targets can't all be within +/- 20cm
+  constexpr int MAX_RC = 100;
+
+  static bool in_range(int v, int lo, int hi, const char *name, std::string &error)
+  {
+    if (v < lo || v > hi) {
+      error = std::string(name) + " " + std::to_string(v) + " is out of range " +
+              std::to_string(lo) + " to " + std::to_string(hi);
+      return false;
+    }
+    return true;
+  }
+
+  static bool check_point(int x, int y, int z, const char *name, std::string &error)
+  {
+    if (!in_range(x, -MAX_COORD, MAX_COORD, name, error) ||
+        !in_range(y, -MAX_COORD, MAX_COORD, name, error) ||
+        !in_range(z, -MAX_COORD, MAX_COORD, name, error)) {
+      return false;
+    }
+    if (std::abs(x) <= MIN_COORD && std::abs(y) <= MIN_COORD && std::abs(z) <= MIN_COORD) {
+      error = std::string(name) + " is within " + std::to_string(MIN_COORD) + "cm of the drone";
+      return false;
+    }
+    return true;
+  }
+
+  static std::string join(const char *verb, std::initializer_list<int> args)
+  {
+    std::string text{verb};
+    for (int arg : args) {
+      text += " " + std::to_string(arg);
+    }
+    return text;
+  }
+
+  bool encode_command(const TelloCommand &command, std::string &text, std::string &error)
+  {
+    static const char *MOVES[] = {"up", "down", "left", "right", "forward", "back"};
+    static const char *FLIPS[] = {"l", "r", "f", "b"};
+
+    switch (command.type) {
+      case TelloCommand::TAKEOFF:
+        text = "takeoff";
+        return true;
+
+      case TelloCommand::LAND:
+        text = "land";
+        return true;
+
+      case TelloCommand::EMERGENCY:
+        text = "emergency";
+        return true;
+
+      case TelloCommand::STOP:
+        text = "stop";
+        return true;
+
+      case TelloCommand::UP:
+      case TelloCommand::DOWN:
+      case TelloCommand::LEFT:
+      case TelloCommand::RIGHT:
+      case TelloCommand::FORWARD:
+      case TelloCommand::BACK:
+        if (!in_range(command.value, MIN_DISTANCE, MAX_DISTANCE, "distance", error)) {
+          return false;
+        }
+        text = join(MOVES[command.type - TelloCommand::UP], {command.value});
+        return true;
+
+      case TelloCommand::CW:
+      case TelloCommand::CCW:
+        if (!in_range(command.value, MIN_ANGLE, MAX_ANGLE, "angle", error)) {
+          return false;
+        }
+        text = join(command.type == TelloCommand::CW ? "cw" : "ccw", {command.value});
+        return true;
+
+      case TelloCommand::FLIP:
+        if (command.flip < TelloCommand::FLIP_LEFT || command.flip > TelloCommand::FLIP_BACK) {
+          error = "unknown flip direction " + std::to_string(command.flip);
+          return false;
+        }
+        text = std::string("flip ") + FLIPS[command.flip - TelloCommand::FLIP_LEFT];
+        return true;
+
+      case TelloCommand::GO:
+        if (!check_point(command.x1, command.y1, command.z1, "target", error) ||
+            !in_range(command.speed, MIN_SPEED, MAX_SPEED, "speed", error)) {
+          return false;
+        }
+        text = join("go", {command.x1, command.y1, command.z1, command.speed});
+        return true;
+
+      case TelloCommand::CURVE:
+        if (!check_point(command.x1, command.y1, command.z1, "first point", error) ||
+            !check_point(command.x2, command.y2, command.z2, "second point", error) ||
+            !in_range(command.speed, MIN_SPEED, MAX_CURVE_SPEED, "speed", error)) {
+          return false;
+        }
+        text = join("curve", {command.x1, command.y1, command.z1, command.x2, command.y2, command.z2, command.speed});
+        return true;
+
+      case TelloCommand::SPEED:
+        if (!in_range(command.value, MIN_SPEED, MAX_SPEED, "speed", error)) {
+          return false;
+        }
+        text = join("speed", {command.value});
+        return true;
+
+      case TelloCommand::RC:
+        if (!in_range(command.rc_lr, -MAX_RC, MAX_RC, "rc_lr", error) ||
+            !in_range(command.rc_fb, -MAX_RC, MAX_RC, "rc_fb", error) ||
+            !in_range(command.rc_ud, -MAX_RC, MAX_RC, "rc_ud", error) ||
+            !in_range(command.rc_yaw, -MAX_RC, MAX_RC, "rc_yaw", error)) {
+          return false;
+        }
+        text = join("rc", {command.rc_lr, command.rc_fb, command.rc_ud, command.rc_yaw});
+        return true;
+
+      default:
+        error = "unknown command type " + std::to_string(command.type);
+        return false;
+    }
+  }
+
+} // namespace tello_driver
@@ -0,0 +1,54 @@
+#include "tello_core.hpp"
+
+#include <regex>
+
+namespace tello_driver
+{
+
+  TelloCore::TelloCore(const CoreConfig &config, CoreCallbacks callbacks) :
+    callbacks_(std::move(callbacks))
+  {
+    command_socket_ = std::make_unique<CommandSocket>(this, config.binding, config.drone_ip, config.drone_port,
+                                                      config.command_port);
+    state_socket_ = std::make_unique<StateSocket>(this, config.binding, config.data_port);
+    video_socket_ = std::make_unique<VideoSocket>(this, config.binding, config.video_port);
+  }
+
+  TelloCore::~TelloCore()
+  {
+    // The video and state threads may call back into the command socket, stop them first
+    video_socket_->stop();
+    state_socket_->stop();
+    command_socket_->stop();
+  }
+
+  // Goals:
+  // * make the data useful by parsing all documented fields
+  // * some future SDK version might introduce new field types, so don't parse undocumented fields
+  // * send the raw string as well
+
+  // Split on ";" and ":" and generate a key:value map
+  std::map<std::string, std::string> TelloCore::parse_fields(const std::string &raw)
+  {
+    std::map<std::string, std::string> fields;
+    std::regex re("([^:]+):([^;]+);");
+    for (auto i = std::sregex_iterator(raw.begin(), raw.end(), re); i != std::sregex_iterator(); ++i) {
+      auto match = *i;
+      fields[match[1]] = match[2];
+    }
+    return fields;
+  }
+
+  void TelloCore::log(LogLevel level, const std::string &msg) const
+  {
+    if (callbacks_.log) {
+      callbacks_.log(level, msg);
+    }
+  }
+
+  bool TelloCore::log_enabled(LogLevel level) const
+  {
+    return callbacks_.log && (!callbacks_.log_enabled || callbacks_.log_enabled(level));
+  }
+
+} // namespace tello_driver
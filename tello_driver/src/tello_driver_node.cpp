@@ -1,12 +1,27 @@
 #include "tello_driver_node.hpp"
 
-#include "ros2_shared/context_macros.hpp"
+#include <set>
 
-using asio::ip::udp;
+#include "rclcpp/create_timer.hpp"
+#include "ros2_shared/context_macros.hpp"
 
 namespace tello_driver
 {
 
+// Video pipeline parameters, these can change at runtime
+#define TELLO_DRIVER_PIPELINE_PARAMS \
+  CXT_MACRO_MEMBER(               /* Decode mode: "all" or "keyframes_only", can change at runtime */ \
+  decode_mode, \
+  std::string, "all") \
+  CXT_MACRO_MEMBER(               /* Convert pixels in this many horizontal stripes, each on its own thread, can change at runtime */ \
+  convert_stripes, \
+  int, 1) \
+  CXT_MACRO_MEMBER(               /* image_raw encoding: "bgr8" or "rgb8", can change at runtime */ \
+  image_encoding, \
+  std::string, "bgr8") \
+  /* End of list */
+
+// All parameters, the rest are read once at startup
 #define TELLO_DRIVER_ALL_PARAMS \
   CXT_MACRO_MEMBER(               /* Send commands to this IP address */ \
   drone_ip, \
@@ -23,9 +38,88 @@ namespace tello_driver
   CXT_MACRO_MEMBER(               /* Video data will arrive at this port */ \
   video_port, \
   int, 11111) \
+  CXT_MACRO_MEMBER(               /* Bind all sockets to this network interface, "" for all interfaces */ \
+  bind_interface, \
+  std::string, "") \
+  CXT_MACRO_MEMBER(               /* Bind all sockets to this local address, "" for any address */ \
+  bind_address, \
+  std::string, "") \
   CXT_MACRO_MEMBER(               /* Camera calibration path */ \
   camera_info_path, \
   std::string, "install/tello_driver/share/tello_driver/cfg/camera_info.yaml") \
+  CXT_MACRO_MEMBER(               /* Log parsed telemetry to this columnar file, "" to disable */ \
+  telemetry_log_path, \
+  std::string, "") \
+  TELLO_DRIVER_PIPELINE_PARAMS \
+  CXT_MACRO_MEMBER(               /* Write decoded frames to this POSIX shared memory ring, "" to disable */ \
+  shm_ring_name, \
+  std::string, "") \
+  CXT_MACRO_MEMBER(               /* Number of frames in the shared memory ring */ \
+  shm_ring_slots, \
+  int, 4) \
+  CXT_MACRO_MEMBER(               /* Publish decoded frames at an even rate, after at least this delay in seconds, 0 to disable */ \
+  playout_delay, \
+  double, 0.0) \
+  CXT_MACRO_MEMBER(               /* Drop frames that would be published later than this, in seconds */ \
+  playout_max_delay, \
+  double, 0.5) \
+  CXT_MACRO_MEMBER(               /* Raise the playout delay above playout_delay to cover the measured jitter */ \
+  playout_adaptive, \
+  bool, true) \
+  CXT_MACRO_MEMBER(               /* Keep this many bytes of recent video and telemetry in memory, 0 to disable */ \
+  blackbox_bytes, \
+  int, 0) \
+  CXT_MACRO_MEMBER(               /* Keep this many seconds of recent video and telemetry */ \
+  blackbox_seconds, \
+  double, 30.0) \
+  CXT_MACRO_MEMBER(               /* Write black box dumps to this directory */ \
+  blackbox_dir, \
+  std::string, ".") \
+  CXT_MACRO_MEMBER(               /* Dump if the acceleration exceeds this, in agx/agy/agz units (~1000 per g), 0 to disable */ \
+  blackbox_crash_accel, \
+  double, 3000.0) \
+  CXT_MACRO_MEMBER(               /* Dump if the battery drops below this percentage, 0 to disable */ \
+  blackbox_low_battery, \
+  int, 10) \
+  CXT_MACRO_MEMBER(               /* Video resolution sent at connect: "high", "low" or "" for the drone default */ \
+  video_resolution, \
+  std::string, "") \
+  CXT_MACRO_MEMBER(               /* Video frame rate sent at connect: "high", "middle", "low" or "" for the drone default */ \
+  video_fps, \
+  std::string, "") \
+  CXT_MACRO_MEMBER(               /* Video bitrate in Mbps sent at connect: 0 (auto) to 5, or -1 for the drone default */ \
+  video_bitrate, \
+  int, -1) \
+  CXT_MACRO_MEMBER(               /* Load this controller plugin, e.g., "tello_driver::AltitudeHoldController", "" for none */ \
+  controller, \
+  std::string, "") \
+  CXT_MACRO_MEMBER(               /* Refresh cached query answers older than this, in seconds */ \
+  query_ttl, \
+  double, 10.0) \
+  CXT_MACRO_MEMBER(               /* Only refresh if no command has been sent for this long, in seconds */ \
+  query_idle, \
+  double, 0.5) \
+  CXT_MACRO_MEMBER(               /* Adapt video bitrate and resolution to the link, requires SDK 2.0+ */ \
+  adaptive_bitrate, \
+  bool, false) \
+  CXT_MACRO_MEMBER(               /* Step down if the video error rate is above this */ \
+  bitrate_error_high, \
+  double, 0.1) \
+  CXT_MACRO_MEMBER(               /* Step up only if the video error rate is below this */ \
+  bitrate_error_low, \
+  double, 0.01) \
+  CXT_MACRO_MEMBER(               /* Step down if the wifi SNR is below this */ \
+  bitrate_snr_low, \
+  int, 20) \
+  CXT_MACRO_MEMBER(               /* Step up only if the wifi SNR is above this */ \
+  bitrate_snr_high, \
+  int, 50) \
+  CXT_MACRO_MEMBER(               /* Step down after this many bad seconds in a row */ \
+  bitrate_down_count, \
+  int, 2) \
+  CXT_MACRO_MEMBER(               /* Step up after this many good seconds in a row */ \
+  bitrate_up_count, \
+  int, 10) \
   /* End of list */
 
   struct TelloDriverContext
@@ -35,55 +129,400 @@ namespace tello_driver
     CXT_MACRO_DEFINE_MEMBERS(TELLO_DRIVER_ALL_PARAMS)
   };
 
+  // Parameters that are read once at startup, changing them later would have no effect
+  static bool read_once(const std::string &name)
+  {
+#undef CXT_MACRO_MEMBER
+#define CXT_MACRO_MEMBER(n, t, d) #n,
+    static const std::set<std::string> all{TELLO_DRIVER_ALL_PARAMS};
+    static const std::set<std::string> pipeline{TELLO_DRIVER_PIPELINE_PARAMS};
+    return all.count(name) > 0 && pipeline.count(name) == 0;
+  }
+
   constexpr int32_t STATE_TIMEOUT = 4;      // We stopped receiving telemetry
   constexpr int32_t VIDEO_TIMEOUT = 4;      // We stopped receiving video
   constexpr int32_t KEEP_ALIVE = 12;        // We stopped receiving input from other ROS nodes
   constexpr int32_t COMMAND_TIMEOUT = 9;    // Drone didn't respond to a command
 
+  // Queries answered from the most recent state packet, mapped to the state field
+  static const std::map<std::string, std::string> TELEMETRY_QUERIES{
+    {"battery?", "bat"},
+    {"time?",    "time"},
+    {"tof?",     "tof"},
+    {"baro?",    "baro"},
+    {"height?",  "h"}};
+
+  // Queries answered from the cache, refreshed in the background
+  static const std::set<std::string> POLLED_QUERIES{
+    "speed?",
+    "wifi?",
+    "sdk?",
+    "sn?"};
+
   TelloDriverNode::TelloDriverNode(const rclcpp::NodeOptions &options) :
-    Node("tello_driver", options)
+    Node("tello_driver", options),
+    command_time_(0L, RCL_ROS_TIME),
+    state_time_(0L, RCL_ROS_TIME),
+    video_time_(0L, RCL_ROS_TIME),
+    cxt_(std::make_unique<TelloDriverContext>())
   {
-    // ROS publishers
-    image_pub_ = create_publisher<sensor_msgs::msg::Image>("image_raw", 1);
-    camera_info_pub_ = create_publisher<sensor_msgs::msg::CameraInfo>("camera_info", rclcpp::SensorDataQoS());
-    flight_data_pub_ = create_publisher<tello_msgs::msg::FlightData>("flight_data", 1);
-    tello_response_pub_ = create_publisher<tello_msgs::msg::TelloResponse>("tello_response", 1);
+    // ROS publishers, QoS and max rate are set by parameters
+    image_pub_ = create_publisher<sensor_msgs::msg::Image>(
+      "image_raw", topic_qos("image_raw", rclcpp::QoS(1), &image_governor_));
+    image_gray_pub_ = create_publisher<sensor_msgs::msg::Image>(
+      "image_gray", topic_qos("image_gray", rclcpp::QoS(1), &image_gray_governor_));
+    camera_info_pub_ = create_publisher<sensor_msgs::msg::CameraInfo>(
+      "camera_info", topic_qos("camera_info", rclcpp::SensorDataQoS(), &camera_info_governor_));
+    flight_data_pub_ = create_publisher<tello_msgs::msg::FlightData>(
+      "flight_data", topic_qos("flight_data", rclcpp::QoS(1), &flight_data_governor_));
+    tello_response_pub_ = create_publisher<tello_msgs::msg::TelloResponse>(
+      "tello_response", topic_qos("tello_response", rclcpp::QoS(1)));
+    mission_status_pub_ = create_publisher<tello_msgs::msg::MissionStatus>(
+      "mission_status", topic_qos("mission_status", rclcpp::QoS(10)));
+    playout_stats_pub_ = create_publisher<tello_msgs::msg::PlayoutStats>(
+      "playout_stats", topic_qos("playout_stats", rclcpp::QoS(10)));
+    schedule_report_pub_ = create_publisher<tello_msgs::msg::ScheduleReport>(
+      "schedule_report", topic_qos("schedule_report", rclcpp::QoS(10)));
 
     // ROS service
     command_srv_ = create_service<tello_msgs::srv::TelloAction>(
       "tello_action", std::bind(&TelloDriverNode::command_callback, this,
                                 std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    typed_command_srv_ = create_service<tello_msgs::srv::TelloTypedAction>(
+      "tello_typed_action", std::bind(&TelloDriverNode::typed_command_callback, this,
+                                      std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    mission_srv_ = create_service<tello_msgs::srv::TelloMission>(
+      "tello_mission", std::bind(&TelloDriverNode::mission_callback, this,
+                                 std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    query_srv_ = create_service<tello_msgs::srv::TelloQuery>(
+      "tello_query", std::bind(&TelloDriverNode::query_callback, this,
+                               std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    schedule_srv_ = create_service<tello_msgs::srv::TelloSchedule>(
+      "tello_schedule", std::bind(&TelloDriverNode::schedule_callback, this,
+                                  std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    capture_still_srv_ = create_service<tello_msgs::srv::TelloCaptureStill>(
+      "capture_still", std::bind(&TelloDriverNode::capture_still_callback, this,
+                                 std::placeholders::_1, std::placeholders::_2));
+    black_box_srv_ = create_service<tello_msgs::srv::TelloBlackBox>(
+      "tello_black_box", std::bind(&TelloDriverNode::black_box_callback, this,
+                                   std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
 
     // ROS subscription
     cmd_vel_sub_ = create_subscription<geometry_msgs::msg::Twist>(
       "cmd_vel", 1, std::bind(&TelloDriverNode::cmd_vel_callback, this, std::placeholders::_1));
 
-    // ROS timer
+    // ROS timer, uses ROS time so that it follows use_sim_time
     using namespace std::chrono_literals;
-    spin_timer_ = create_wall_timer(1s, std::bind(&TelloDriverNode::timer_callback, this));
+    spin_timer_ = rclcpp::create_timer(this, get_clock(), 1s, std::bind(&TelloDriverNode::timer_callback, this));
 
-    // Parameters - Allocate the parameter context as a local variable because it is not used outside this routine
-    TelloDriverContext cxt{};
+    // Parameters - The video pipeline parameters can be changed while the node is running, the rest are read once
+    auto &cxt = *cxt_;
 #undef CXT_MACRO_MEMBER
 #define CXT_MACRO_MEMBER(n, t, d) CXT_MACRO_LOAD_PARAMETER((*this), cxt, n, t, d)
     CXT_MACRO_INIT_PARAMETERS(TELLO_DRIVER_ALL_PARAMS, [this]()
     {})
 
-    // NOTE: This is not setup to dynamically update parameters after ths node is running.
+#undef CXT_MACRO_MEMBER
+#define CXT_MACRO_MEMBER(n, t, d) CXT_MACRO_PARAMETER_CHANGED((*cxt_), n, t)
+    CXT_MACRO_REGISTER_PARAMETERS_CHANGED((*this), TELLO_DRIVER_PIPELINE_PARAMS, [this]()
+    { apply_pipeline(); })
+
+    // Rate limits can also change, other parameters can't
+    rate_callback_handle_ = add_on_set_parameters_callback(
+      std::bind(&TelloDriverNode::rate_callback, this, std::placeholders::_1));
+
+    query_ttl_ = cxt.query_ttl_;
+    query_idle_ = cxt.query_idle_;
+
+    // Video settings require SDK 2.0+ (setbitrate) or SDK 3.0 (setresolution, setfps)
+    if (!cxt.video_resolution_.empty()) {
+      video_commands_.push_back("setresolution " + cxt.video_resolution_);
+    }
+    if (!cxt.video_fps_.empty()) {
+      video_commands_.push_back("setfps " + cxt.video_fps_);
+    }
+    if (cxt.video_bitrate_ >= 0) {
+      video_commands_.push_back("setbitrate " + std::to_string(cxt.video_bitrate_));
+    }
+
+    if (cxt.adaptive_bitrate_) {
+      bitrate_controller_ = std::make_unique<BitrateController>(BitrateController::Config{
+        cxt.bitrate_error_high_, cxt.bitrate_error_low_,
+        cxt.bitrate_snr_low_, cxt.bitrate_snr_high_,
+        cxt.bitrate_down_count_, cxt.bitrate_up_count_});
+    }
 
     RCLCPP_INFO(get_logger(), "Drone at %s:%d", cxt.drone_ip_.c_str(), cxt.drone_port_);
     RCLCPP_INFO(get_logger(), "Listening for command responses on localhost:%d", cxt.command_port_);
     RCLCPP_INFO(get_logger(), "Listening for data on localhost:%d", cxt.data_port_);
     RCLCPP_INFO(get_logger(), "Listening for video on localhost:%d", cxt.video_port_);
+    if (!cxt.bind_interface_.empty() || !cxt.bind_address_.empty()) {
+      RCLCPP_INFO(get_logger(), "Binding to interface '%s', address '%s'",
+                  cxt.bind_interface_.c_str(), cxt.bind_address_.c_str());
+    }
+
+    // Missions send commands from the socket threads, without a response on tello_response
+    mission_executor_ = std::make_unique<MissionExecutor>(this, [this](const std::string &command)
+    {
+      return core_ && core_->initiate_command(command, false);
+    });
 
-    // Sockets
-    command_socket_ = std::make_unique<CommandSocket>(this, cxt.drone_ip_, cxt.drone_port_, cxt.command_port_);
-    state_socket_ = std::make_unique<StateSocket>(this, cxt.data_port_);
-    video_socket_ = std::make_unique<VideoSocket>(this, cxt.video_port_, cxt.camera_info_path_);
+    // The controller is called by the state socket, load it first
+    if (!cxt.controller_.empty()) {
+      controller_loader_ = std::make_unique<pluginlib::ClassLoader<Controller>>(
+        "tello_driver", "tello_driver::Controller");
+      try {
+        controller_ = controller_loader_->createSharedInstance(cxt.controller_);
+        controller_->initialize(*this);
+        RCLCPP_INFO(get_logger(), "Loaded controller %s, ignoring cmd_vel", cxt.controller_.c_str());
+      } catch (pluginlib::PluginlibException &e) {
+        RCLCPP_ERROR(get_logger(), "Can't load controller %s: %s", cxt.controller_.c_str(), e.what());
+        controller_.reset();
+      } catch (std::exception &e) {
+        // E.g., initialize() declared a parameter that already exists, or with the wrong type
+        RCLCPP_ERROR(get_logger(), "Can't initialize controller %s: %s", cxt.controller_.c_str(), e.what());
+        controller_.reset();
+      }
+    }
+
+    if (cxt.blackbox_bytes_ > 0) {
+      RCLCPP_INFO(get_logger(), "Black box keeps %gs or %d bytes, dumps to %s", cxt.blackbox_seconds_,
+                  cxt.blackbox_bytes_, cxt.blackbox_dir_.c_str());
+      black_box_ = std::make_unique<BlackBox>(BlackBox::Config{
+        static_cast<size_t>(cxt.blackbox_bytes_), cxt.blackbox_seconds_, cxt.blackbox_dir_,
+        cxt.blackbox_crash_accel_, cxt.blackbox_low_battery_},
+                                              std::bind(&TelloDriverNode::on_log, this,
+                                                        std::placeholders::_1, std::placeholders::_2));
+    }
+
+    // Adapters, called by the core
+    flight_data_publisher_ = std::make_unique<FlightDataPublisher>(this, cxt.telemetry_log_path_);
+    auto pipeline = pipeline_config();
+    video_publisher_ = std::make_unique<VideoPublisher>(this, VideoConfig{
+      cxt.camera_info_path_, cxt.shm_ring_name_, cxt.shm_ring_slots_,
+      PlayoutBuffer::Config{cxt.playout_delay_, std::max(cxt.playout_delay_, cxt.playout_max_delay_),
+                            cxt.playout_adaptive_}}, pipeline);
+
+    // The core starts receiving as soon as it's created
+    CoreCallbacks callbacks;
+    callbacks.log = std::bind(&TelloDriverNode::on_log, this, std::placeholders::_1, std::placeholders::_2);
+    callbacks.log_enabled = [this](LogLevel level)
+    {
+      // Only debug messages are filtered, the severity can change at runtime
+      return level != LogLevel::debug ||
+             rcutils_logging_logger_is_enabled_for(get_logger().get_name(), RCUTILS_LOG_SEVERITY_DEBUG);
+    };
+    callbacks.state = std::bind(&FlightDataPublisher::on_state, flight_data_publisher_.get(),
+                                std::placeholders::_1, std::placeholders::_2);
+    callbacks.response = std::bind(&TelloDriverNode::on_response, this, std::placeholders::_1,
+                                   std::placeholders::_2, std::placeholders::_3, std::placeholders::_4);
+    callbacks.frame = std::bind(&VideoPublisher::on_frame, video_publisher_.get(),
+                                std::placeholders::_1, std::placeholders::_2);
+    if (black_box_) {
+      callbacks.access_unit = std::bind(&BlackBox::on_access_unit, black_box_.get(),
+                                        std::placeholders::_1, std::placeholders::_2);
+    }
+
+    core_ = std::make_unique<TelloCore>(CoreConfig{
+      cxt.drone_ip_, static_cast<unsigned short>(cxt.drone_port_), static_cast<unsigned short>(cxt.command_port_),
+      static_cast<unsigned short>(cxt.data_port_), static_cast<unsigned short>(cxt.video_port_),
+      SocketBinding{cxt.bind_interface_, cxt.bind_address_}}, callbacks);
+    core_->set_keyframes_only(pipeline.keyframes_only);
   }
 
   TelloDriverNode::~TelloDriverNode()
   {
+    // Scheduled commands refer to the core
+    CommandScheduler::instance().cancel(this);
+
+    // Stop the core threads before the adapters go away
+    core_.reset();
+
+    // The still thread responds through capture_still_srv_
+    video_publisher_.reset();
+  }
+
+  void TelloDriverNode::on_log(LogLevel level, const std::string &msg)
+  {
+    switch (level) {
+      case LogLevel::debug:
+        RCLCPP_DEBUG(get_logger(), "%s", msg.c_str());
+        break;
+      case LogLevel::info:
+        RCLCPP_INFO(get_logger(), "%s", msg.c_str());
+        break;
+      case LogLevel::warn:
+        RCLCPP_WARN(get_logger(), "%s", msg.c_str());
+        break;
+      case LogLevel::error:
+        RCLCPP_ERROR(get_logger(), "%s", msg.c_str());
+        break;
+    }
+  }
+
+  // Called by the core command thread, or by the ROS thread on a timeout
+  void TelloDriverNode::on_response(const std::string &command, CommandResult result, const std::string &str,
+                                    bool respond)
+  {
+    uint8_t rc = tello_msgs::msg::TelloResponse::OK;
+    if (result == CommandResult::error) {
+      rc = tello_msgs::msg::TelloResponse::ERROR;
+    } else if (result == CommandResult::timeout) {
+      rc = tello_msgs::msg::TelloResponse::TIMEOUT;
+    }
+
+    auto stamp = now();
+
+    // Remember answers to queries, whoever sent them
+    if (result == CommandResult::ok && QueryCache::is_query(command) && str.rfind("unknown command", 0) != 0) {
+      query_cache_.store(command, str, stamp);
+    }
+
+    if (respond) {
+      tello_msgs::msg::TelloResponse response_msg;
+      response_msg.rc = rc;
+      response_msg.str = str;
+      tello_response_pub_->publish(response_msg);
+    }
+
+    // The mission may send its next command
+    mission_executor_->on_response(rc, str, stamp);
+  }
+
+  void TelloDriverNode::note_activity()
+  {
+    auto stamp = now();
+
+    uint64_t commands_sent = core_->commands_sent();
+    if (commands_sent != commands_sent_) {
+      commands_sent_ = commands_sent;
+      command_time_ = stamp;
+    }
+
+    uint64_t state_packets = core_->state_packets();
+    if (state_packets != state_packets_) {
+      state_packets_ = state_packets;
+      state_time_ = stamp;
+    }
+
+    uint64_t video_packets = core_->video_packets();
+    if (video_packets != video_packets_) {
+      video_packets_ = video_packets;
+      video_time_ = stamp;
+    }
+  }
+
+  bool TelloDriverNode::send_setpoint(const RcSetpoint &setpoint)
+  {
+    tello_msgs::msg::TelloCommand rc;
+    rc.type = rc.RC;
+    rc.rc_lr = std::max(-100, std::min(100, setpoint.lr));
+    rc.rc_fb = std::max(-100, std::min(100, setpoint.fb));
+    rc.rc_ud = std::max(-100, std::min(100, setpoint.ud));
+    rc.rc_yaw = std::max(-100, std::min(100, setpoint.yaw));
+
+    std::string text, error;
+    return encode_command(rc, text, error) && core_ && core_->initiate_command(text, false);
+  }
+
+  PipelineConfig TelloDriverNode::pipeline_config()
+  {
+    PipelineConfig pipeline{false, cxt_->convert_stripes_, cxt_->image_encoding_};
+
+    if (cxt_->decode_mode_ == "keyframes_only") {
+      pipeline.keyframes_only = true;
+    } else if (cxt_->decode_mode_ != "all") {
+      RCLCPP_ERROR(get_logger(), "Unknown decode_mode '%s', decoding all frames", cxt_->decode_mode_.c_str());
+    }
+
+    if (pipeline.encoding != sensor_msgs::image_encodings::BGR8 &&
+        pipeline.encoding != sensor_msgs::image_encodings::RGB8) {
+      RCLCPP_ERROR(get_logger(), "Unknown image_encoding '%s', using bgr8", pipeline.encoding.c_str());
+      pipeline.encoding = sensor_msgs::image_encodings::BGR8;
+    }
+
+    return pipeline;
+  }
+
+  void TelloDriverNode::apply_pipeline()
+  {
+    // Called for every parameter change, the video thread ignores a config that hasn't changed
+    if (core_) {
+      auto pipeline = pipeline_config();
+      core_->set_keyframes_only(pipeline.keyframes_only);
+      video_publisher_->set_pipeline(pipeline);
+    }
+  }
+
+  rcl_interfaces::msg::SetParametersResult TelloDriverNode::rate_callback(
+    const std::vector<rclcpp::Parameter> &parameters)
+  {
+    rcl_interfaces::msg::SetParametersResult result;
+    result.successful = true;
+
+    for (const auto &parameter : parameters) {
+      if (read_once(parameter.get_name())) {
+        result.successful = false;
+        result.reason = parameter.get_name() + " is read at startup, it can't be changed";
+        return result;
+      }
+
+      auto governor = governors_.find(parameter.get_name());
+      if (governor != governors_.end()) {
+        if (parameter.get_type() != rclcpp::ParameterType::PARAMETER_DOUBLE) {
+          result.successful = false;
+          result.reason = parameter.get_name() + " must be a double";
+        } else {
+          RCLCPP_INFO(get_logger(), "%s is now %g", parameter.get_name().c_str(), parameter.as_double());
+          governor->second->set_max_rate(parameter.as_double());
+        }
+      }
+    }
+
+    return result;
+  }
+
+  rclcpp::QoS TelloDriverNode::topic_qos(const std::string &topic, const rclcpp::QoS &default_qos,
+                                         PublishGovernor *governor)
+  {
+    auto profile = default_qos.get_rmw_qos_profile();
+
+    auto reliability = declare_parameter<std::string>(
+      topic + ".reliability", profile.reliability == RMW_QOS_POLICY_RELIABILITY_BEST_EFFORT ? "best_effort" : "reliable");
+    auto depth = declare_parameter<int>(topic + ".depth", static_cast<int>(profile.depth));
+    auto durability = declare_parameter<std::string>(
+      topic + ".durability", profile.durability == RMW_QOS_POLICY_DURABILITY_TRANSIENT_LOCAL ? "transient_local" : "volatile");
+
+    rclcpp::QoS qos{rclcpp::KeepLast(std::max(1, depth))};
+
+    if (reliability == "best_effort") {
+      qos.best_effort();
+    } else {
+      if (reliability != "reliable") {
+        RCLCPP_ERROR(get_logger(), "Unknown %s.reliability '%s', using reliable", topic.c_str(), reliability.c_str());
+      }
+      qos.reliable();
+    }
+
+    if (durability == "transient_local") {
+      qos.transient_local();
+    } else {
+      if (durability != "volatile") {
+        RCLCPP_ERROR(get_logger(), "Unknown %s.durability '%s', using volatile", topic.c_str(), durability.c_str());
+      }
+      qos.durability_volatile();
+    }
+
+    if (governor) {
+      auto max_rate = declare_parameter<double>(topic + ".max_rate", 0.0);
+      governor->set_max_rate(max_rate);
+      governors_[topic + ".max_rate"] = governor;
+      if (max_rate > 0) {
+        RCLCPP_INFO(get_logger(), "Publish %s at most %g times per second", topic.c_str(), max_rate);
+      }
+    }
+
+    return qos;
   }
 
   void TelloDriverNode::command_callback(
@@ -92,47 +531,269 @@ namespace tello_driver
     std::shared_ptr<tello_msgs::srv::TelloAction::Response> response)
   {
     (void) request_header;
-    if (!state_socket_->receiving() || !video_socket_->receiving()) {
+    if (!core_->state_receiving() || !core_->video_receiving()) {
       RCLCPP_WARN(get_logger(), "Not connected, dropping '%s'", request->cmd.c_str());
       response->rc = response->ERROR_NOT_CONNECTED;
-    } else if (command_socket_->waiting()) {
+    } else if (core_->command_waiting()) {
       RCLCPP_WARN(get_logger(), "Busy, dropping '%s'", request->cmd.c_str());
       response->rc = response->ERROR_BUSY;
     } else {
-      command_socket_->initiate_command(request->cmd, true);
+      core_->initiate_command(request->cmd, true);
+      response->rc = response->OK;
+    }
+  }
+
+  void TelloDriverNode::query_callback(
+    const std::shared_ptr<rmw_request_id_t> request_header,
+    const std::shared_ptr<tello_msgs::srv::TelloQuery::Request> request,
+    std::shared_ptr<tello_msgs::srv::TelloQuery::Response> response)
+  {
+    (void) request_header;
+    auto stamp = now();
+
+    if (!core_->state_receiving()) {
+      response->rc = response->ERROR_NOT_CONNECTED;
+      return;
+    }
+
+    // Answer from the most recent state packet
+    auto t = TELEMETRY_QUERIES.find(request->query);
+    if (t != TELEMETRY_QUERIES.end()) {
+      CoreClock::time_point answer_time;
+      if (core_->state_field(t->second, response->str, answer_time)) {
+        response->rc = response->OK;
+        response->age = std::chrono::duration<float>(CoreClock::now() - answer_time).count();
+      } else {
+        response->rc = response->ERROR_NOT_AVAILABLE;
+      }
+      return;
+    }
+
+    if (POLLED_QUERIES.find(request->query) == POLLED_QUERIES.end()) {
+      RCLCPP_WARN(get_logger(), "Unknown query '%s'", request->query.c_str());
+      response->rc = response->ERROR_UNKNOWN_QUERY;
+      return;
+    }
+
+    // Answer from the cache, the timer will refresh stale answers
+    QueryCache::Entry entry;
+    if (query_cache_.request(request->query, stamp, entry)) {
+      double max_age = request->max_age > 0 ? request->max_age : query_ttl_;
+      response->str = entry.value;
+      response->age = static_cast<float>((stamp - entry.answer_time).seconds());
+      if (response->age <= max_age) {
+        response->rc = response->OK;
+      } else {
+        response->rc = response->STALE;
+        query_cache_.mark_stale(request->query);
+      }
+    } else {
+      response->rc = response->ERROR_NOT_AVAILABLE;
+    }
+  }
+
+  void TelloDriverNode::typed_command_callback(
+    const std::shared_ptr<rmw_request_id_t> request_header,
+    const std::shared_ptr<tello_msgs::srv::TelloTypedAction::Request> request,
+    std::shared_ptr<tello_msgs::srv::TelloTypedAction::Response> response)
+  {
+    (void) request_header;
+    std::string text;
+    if (!encode_command(request->command, text, response->str)) {
+      RCLCPP_WARN(get_logger(), "Invalid command, %s", response->str.c_str());
+      response->rc = response->ERROR_INVALID;
+    } else if (!core_->state_receiving() || !core_->video_receiving()) {
+      RCLCPP_WARN(get_logger(), "Not connected, dropping '%s'", text.c_str());
+      response->rc = response->ERROR_NOT_CONNECTED;
+    } else if (core_->command_waiting()) {
+      RCLCPP_WARN(get_logger(), "Busy, dropping '%s'", text.c_str());
+      response->rc = response->ERROR_BUSY;
+    } else {
+      core_->initiate_command(text, true);
       response->rc = response->OK;
+      response->str = text;
+    }
+  }
+
+  void TelloDriverNode::mission_callback(
+    const std::shared_ptr<rmw_request_id_t> request_header,
+    const std::shared_ptr<tello_msgs::srv::TelloMission::Request> request,
+    std::shared_ptr<tello_msgs::srv::TelloMission::Response> response)
+  {
+    (void) request_header;
+    if (request->cancel) {
+      mission_executor_->cancel(now());
+      response->rc = response->OK;
+    } else if (!core_->state_receiving() || !core_->video_receiving()) {
+      RCLCPP_WARN(get_logger(), "Not connected, dropping mission");
+      response->rc = response->ERROR_NOT_CONNECTED;
+    } else if (mission_executor_->running()) {
+      response->rc = response->ERROR_BUSY;
+      response->str = "a mission is already running";
+    } else if (!mission_executor_->start(request->steps, now(), response->str)) {
+      RCLCPP_WARN(get_logger(), "Invalid mission, %s", response->str.c_str());
+      response->rc = response->ERROR_INVALID;
+    } else {
+      response->rc = response->OK;
+    }
+  }
+
+  void TelloDriverNode::schedule_callback(
+    const std::shared_ptr<rmw_request_id_t> request_header,
+    const std::shared_ptr<tello_msgs::srv::TelloSchedule::Request> request,
+    std::shared_ptr<tello_msgs::srv::TelloSchedule::Response> response)
+  {
+    (void) request_header;
+    auto &scheduler = CommandScheduler::instance();
+
+    if (request->cancel) {
+      scheduler.cancel(this);
+    }
+
+    // Encode everything before scheduling anything
+    std::vector<std::pair<int64_t, std::string>> commands;
+    for (size_t i = 0; i < request->commands.size(); ++i) {
+      const auto &scheduled = request->commands[i];
+      std::string text, error;
+      if (!encode_command(scheduled.command, text, error)) {
+        response->rc = response->ERROR_INVALID;
+        response->str = "command " + std::to_string(i) + ": " + error;
+        RCLCPP_WARN(get_logger(), "Invalid schedule, %s", response->str.c_str());
+        return;
+      }
+      commands.emplace_back(rclcpp::Time(scheduled.target).nanoseconds(), text);
+    }
+
+    if (!commands.empty() && (!core_->state_receiving() || !core_->video_receiving())) {
+      RCLCPP_WARN(get_logger(), "Not connected, dropping schedule");
+      response->rc = response->ERROR_NOT_CONNECTED;
+      return;
+    }
+
+    if (!commands.empty() && !schedule_warned_ && !scheduler.realtime()) {
+      RCLCPP_WARN(get_logger(), "Can't run the command scheduler at a real-time priority, send times may jitter");
+      schedule_warned_ = true;
+    }
+
+    // Fire on the scheduler thread, report afterwards
+    for (const auto &command : commands) {
+      auto text = command.second;
+      auto target_ns = command.first;
+      scheduler.schedule(this, target_ns, [this, text]()
+      {
+        return core_->initiate_command(text, false);
+      }, [this, text, target_ns](bool sent, int64_t actual_ns)
+      {
+        tello_msgs::msg::ScheduleReport msg;
+        msg.header.stamp = rclcpp::Time(actual_ns, RCL_SYSTEM_TIME);
+        msg.target = rclcpp::Time(target_ns, RCL_SYSTEM_TIME);
+        msg.command = text;
+        msg.sent = sent;
+        msg.error_ns = actual_ns - target_ns;
+        if (!sent) {
+          RCLCPP_WARN(get_logger(), "Busy, dropped scheduled '%s'", text.c_str());
+        }
+        schedule_report_pub_->publish(msg);
+      });
+    }
+
+    response->rc = response->OK;
+  }
+
+  void TelloDriverNode::capture_still_callback(
+    const std::shared_ptr<rmw_request_id_t> request_header,
+    const std::shared_ptr<tello_msgs::srv::TelloCaptureStill::Request> request)
+  {
+    // Keyframe waiters are answered on the still thread, the destructor stops it first
+    video_publisher_->capture_still(request, [this, request_header](VideoPublisher::StillResponse response)
+    {
+      capture_still_srv_->send_response(*request_header, *response);
+    });
+  }
+
+  void TelloDriverNode::black_box_callback(
+    const std::shared_ptr<rmw_request_id_t> request_header,
+    const std::shared_ptr<tello_msgs::srv::TelloBlackBox::Request> request,
+    std::shared_ptr<tello_msgs::srv::TelloBlackBox::Response> response)
+  {
+    (void) request_header;
+    if (!black_box_) {
+      response->rc = response->ERROR_DISABLED;
+      return;
+    }
+
+    switch (black_box_->dump(request->reason, response->video_path, response->telemetry_path)) {
+      case BlackBox::Result::ok:
+        response->rc = response->OK;
+        break;
+      case BlackBox::Result::empty:
+        response->rc = response->ERROR_EMPTY;
+        break;
+      case BlackBox::Result::busy:
+        response->rc = response->ERROR_BUSY;
+        break;
     }
   }
 
+  // Clamp a joystick position to the rc range
+  static int32_t rc_value(double v)
+  {
+    return static_cast<int32_t>(std::max(-100.0, std::min(100.0, round(v * 100))));
+  }
+
   void TelloDriverNode::cmd_vel_callback(const geometry_msgs::msg::Twist::SharedPtr msg)
   {
     // TODO cmd_vel should specify velocity, not joystick position
-    if (!command_socket_->waiting()) {
-      std::ostringstream rc;
-      rc << "rc " << static_cast<int>(round(msg->linear.y * -100))
-         << " " << static_cast<int>(round(msg->linear.x * 100))
-         << " " << static_cast<int>(round(msg->linear.z * 100))
-         << " " << static_cast<int>(round(msg->angular.z * -100));
-      command_socket_->initiate_command(rc.str(), false);
+    // A controller plugin owns rc
+    if (!std::atomic_load(&controller_) && !core_->command_waiting()) {
+      tello_msgs::msg::TelloCommand rc;
+      rc.type = rc.RC;
+      rc.rc_lr = rc_value(-msg->linear.y);
+      rc.rc_fb = rc_value(msg->linear.x);
+      rc.rc_ud = rc_value(msg->linear.z);
+      rc.rc_yaw = rc_value(-msg->angular.z);
+
+      std::string text, error;
+      if (encode_command(rc, text, error)) {
+        core_->initiate_command(text, false);
+      }
     }
   }
 
   // Do work every second
   void TelloDriverNode::timer_callback()
   {
+    // Timeouts and keep-alive are measured in ROS time
+    note_activity();
+
+    // Stills can't wait forever for a keyframe, even if the drone is gone
+    video_publisher_->expire_stills();
+
+    // Mission waits time out even while disconnected
+    mission_executor_->on_tick(now());
+
     //====
     // Startup
     //====
 
-    if (!state_socket_->receiving() && !command_socket_->waiting()) {
+    if (!core_->state_receiving() && !core_->command_waiting()) {
       // First command to the drone must be "command"
-      command_socket_->initiate_command("command", false);
+      core_->initiate_command("command", false);
+      connect_commands_.assign(video_commands_.begin(), video_commands_.end());
+      return;
+    }
+
+    if (core_->state_receiving() && !core_->video_receiving() && !core_->command_waiting() &&
+        !connect_commands_.empty()) {
+      // Video settings must be sent before "streamon"
+      core_->initiate_command(connect_commands_.front(), false);
+      connect_commands_.pop_front();
       return;
     }
 
-    if (state_socket_->receiving() && !video_socket_->receiving() && !command_socket_->waiting()) {
+    if (core_->state_receiving() && !core_->video_receiving() && !core_->command_waiting()) {
       // Start video
-      command_socket_->initiate_command("streamon", false);
+      core_->initiate_command("streamon", false);
       return;
     }
 
@@ -142,21 +803,22 @@ namespace tello_driver
 
     bool timeout = false;
 
-    if (command_socket_->waiting() && now() - command_socket_->send_time() > rclcpp::Duration(COMMAND_TIMEOUT, 0)) {
+    if (core_->command_waiting() && now() - command_time_ > rclcpp::Duration(COMMAND_TIMEOUT, 0)) {
       RCLCPP_ERROR(get_logger(), "Command timed out");
-      command_socket_->timeout();
+      core_->command_timeout();
       timeout = true;
     }
 
-    if (state_socket_->receiving() && now() - state_socket_->receive_time() > rclcpp::Duration(STATE_TIMEOUT, 0)) {
+    if (core_->state_receiving() && now() - state_time_ > rclcpp::Duration(STATE_TIMEOUT, 0)) {
       RCLCPP_ERROR(get_logger(), "No state received for 5s");
-      state_socket_->timeout();
+      core_->state_timeout();
+      mission_executor_->on_telemetry_lost(now());
       timeout = true;
     }
 
-    if (video_socket_->receiving() && now() - video_socket_->receive_time() > rclcpp::Duration(VIDEO_TIMEOUT, 0)) {
+    if (core_->video_receiving() && now() - video_time_ > rclcpp::Duration(VIDEO_TIMEOUT, 0)) {
       RCLCPP_ERROR(get_logger(), "No video received for 5s");
-      video_socket_->timeout();
+      core_->video_timeout();
       timeout = true;
     }
 
@@ -164,15 +826,78 @@ namespace tello_driver
       return;
     }
 
+    //====
+    // Adapt video bitrate to the link
+    //====
+
+    VideoStats video_stats = core_->take_video_stats();
+
+    PlayoutStats playout_stats;
+    if (video_publisher_->take_playout_stats(playout_stats)) {
+      tello_msgs::msg::PlayoutStats msg;
+      msg.header.stamp = now();
+      msg.frames_in = playout_stats.frames_in;
+      msg.frames_out = playout_stats.frames_out;
+      msg.late = playout_stats.late;
+      msg.underruns = playout_stats.underruns;
+      msg.dropped = playout_stats.dropped;
+      msg.target_delay = playout_stats.target_delay;
+      msg.interval = playout_stats.interval;
+      msg.buffered = playout_stats.buffered;
+      playout_stats_pub_->publish(msg);
+    }
+
+    if (bitrate_controller_ && core_->video_receiving()) {
+      // Asking for wifi? keeps the answer fresh, the SNR is unknown until the first answer arrives
+      int snr = -1;
+      QueryCache::Entry entry;
+      if (query_cache_.request("wifi?", now(), entry) &&
+          now() - entry.answer_time < rclcpp::Duration::from_seconds(2 * query_ttl_)) {
+        try {
+          snr = std::stoi(entry.value);
+        } catch (std::exception &e) {
+          RCLCPP_WARN(get_logger(), "Can't parse wifi? answer '%s'", entry.value.c_str());
+        }
+      }
+
+      std::vector<std::string> commands;
+      if (bitrate_controller_->update(video_stats, snr, commands)) {
+        RCLCPP_INFO(get_logger(), "Video link changed (%d/%d errors, snr %d), switching to level %d",
+                    video_stats.dropped + video_stats.errors, video_stats.sequences, snr,
+                    bitrate_controller_->level());
+
+        // Older commands are obsolete
+        bitrate_commands_.assign(commands.begin(), commands.end());
+      }
+    }
+
+    if (!bitrate_commands_.empty() && !core_->command_waiting()) {
+      core_->initiate_command(bitrate_commands_.front(), false);
+      bitrate_commands_.pop_front();
+      return;
+    }
+
     //====
     // Keep-alive, drone will auto-land if it hears nothing for 15s
     //====
 
-    if (state_socket_->receiving() && video_socket_->receiving() && !command_socket_->waiting() &&
-        now() - command_socket_->send_time() > rclcpp::Duration(KEEP_ALIVE, 0)) {
-      command_socket_->initiate_command("rc 0 0 0 0", false);
+    if (core_->state_receiving() && core_->video_receiving() && !core_->command_waiting() &&
+        now() - command_time_ > rclcpp::Duration(KEEP_ALIVE, 0)) {
+      core_->initiate_command("rc 0 0 0 0", false);
       return;
     }
+
+    //====
+    // Refresh cached query answers, but only if the command channel is idle
+    //====
+
+    std::string query;
+    if (core_->state_receiving() && core_->video_receiving() && !core_->command_waiting() &&
+        now() - command_time_ > rclcpp::Duration::from_seconds(query_idle_) &&
+        query_cache_.next_refresh(now(), rclcpp::Duration::from_seconds(query_ttl_), query)) {
+      RCLCPP_DEBUG(get_logger(), "Refreshing '%s'", query.c_str());
+      core_->initiate_command(query, false);
+    }
   }
 
 } // namespace tello_driver
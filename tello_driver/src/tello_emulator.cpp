@@ -1,6 +1,12 @@
+#include <algorithm>
+#include <chrono>
 #include <cstdlib>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <iterator>
 #include <thread>
+#include <vector>
 
 #include <asio.hpp>
 
@@ -15,8 +21,74 @@ const std::string FD_1_3{"pitch:1;roll:5;yaw:0;vgx:0;vgy:0;vgz:0;templ:43;temph:
 const std::string FD_2_0{"mid:-1;x:0;y:0;z:0;mpry:0,0,0;pitch:3;roll:-1;yaw:0;vgx:0;vgy:0;vgz:0;templ:50;temph:54;"
                          "tof:10;h:0;bat:51;baro:147.94;time:0;agx:54.00;agy:28.00;agz:-1004.00;"};
 
+//=====================================================================================
+// Virtual clock: time_scale virtual seconds pass for every real second
+// Run the driver with use_sim_time and tello_sim_clock at the same scale
+//=====================================================================================
+
+class VirtualClock
+{
+  double time_scale_;
+
+public:
+
+  explicit VirtualClock(double time_scale) : time_scale_(time_scale)
+  {}
+
+  void sleep_for(double virtual_seconds) const
+  {
+    std::this_thread::sleep_for(std::chrono::duration<double>(virtual_seconds / time_scale_));
+  }
+};
+
+//=====================================================================================
+// Video: split an h264 Annex B file into access units, each ends with a slice NAL unit
+//=====================================================================================
+
+constexpr size_t VIDEO_PACKET_SIZE = 1460;  // Same as the drone
+constexpr double VIDEO_FPS = 30;
+
+std::vector<std::string> load_access_units(const std::string &path)
+{
+  std::ifstream f(path, std::ios::binary);
+  if (!f) {
+    throw std::runtime_error("cannot open " + path);
+  }
+  std::string data((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+
+  // Find the start of each NAL unit, including the start code
+  std::vector<size_t> starts;
+  for (size_t i = 0; i + 3 < data.size(); ++i) {
+    if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+      starts.push_back(i > 0 && data[i - 1] == 0 ? i - 1 : i);
+      i += 2;
+    }
+  }
+  starts.push_back(data.size());
+
+  std::vector<std::string> access_units;
+  size_t au_start = starts.front();
+  for (size_t n = 0; n + 1 < starts.size(); ++n) {
+    size_t header = data.find('\1', starts[n]) + 1;
+    int nal_type = data[header] & 0x1f;
+    if (nal_type == 1 || nal_type == 5) {
+      access_units.push_back(data.substr(au_start, starts[n + 1] - au_start));
+      au_start = starts[n + 1];
+    }
+  }
+
+  return access_units;
+}
+
+// Monotonic time in seconds, comparable across processes on the same host
+double monotonic_seconds()
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 void emulator(bool emulate_2_0, std::string name,
-  unsigned short drone_port, unsigned short data_port, unsigned short video_port)
+  unsigned short drone_port, unsigned short data_port, unsigned short video_port, const VirtualClock &clock,
+  const std::vector<std::string> &access_units)
 {
   asio::io_service io_service;
 
@@ -46,11 +118,12 @@ void emulator(bool emulate_2_0, std::string name,
     unsigned short port = sender_endpoint.port();
 
     std::string command(std::begin(buffer), std::begin(buffer) + length);
-    std::cout << name << " heard '" << command << "' from " << address << ":" << port << std::endl;
+    std::cout << name << " heard '" << command << "' from " << address << ":" << port
+      << " at " << std::fixed << std::setprecision(6) << monotonic_seconds() << std::endl;
 
     // Simulate a long command
     if (command == "takeoff" || command == "land") {
-      sleep(5);
+      clock.sleep_for(5);
     }
 
     // Respond to all commands except "rc"
@@ -60,23 +133,27 @@ void emulator(bool emulate_2_0, std::string name,
       } else {
         command_socket.send_to(asio::buffer(std::string("unknown command: sdk?")), sender_endpoint);
       }
+    } else if (command.rfind("wifi?", 0) == 0) {
+      command_socket.send_to(asio::buffer(std::string("90")), sender_endpoint);
     } else if (command.rfind("rc", 0) != 0) {
       command_socket.send_to(asio::buffer(std::string("ok")), sender_endpoint);
     }
 
-    // If we heard "command" then start sending state messages
+    // Like the drone, send state and video to whoever sent "command"
     if (!connected && command == "command")
     {
       connected = true;
+      state_remote_endpoint = udp::endpoint(sender_endpoint.address(), data_port);
+      video_remote_endpoint = udp::endpoint(sender_endpoint.address(), video_port);
       auto flight_data = emulate_2_0 ? FD_2_0 : FD_1_3;
 
       state_thread = std::thread(
-        [&state_socket, &state_remote_endpoint, flight_data]()
+        [&state_socket, &state_remote_endpoint, &clock, flight_data]()
         {
           for (;;)
           {
             state_socket.send_to(asio::buffer(flight_data), state_remote_endpoint);
-            sleep(1);
+            clock.sleep_for(1);
           }
         });
     }
@@ -86,15 +163,33 @@ void emulator(bool emulate_2_0, std::string name,
     {
       streaming = true;
 
-      video_thread = std::thread(
-        [&video_socket, &video_remote_endpoint]()
-        {
-          for (;;)
+      if (access_units.empty()) {
+        video_thread = std::thread(
+          [&video_socket, &video_remote_endpoint, &clock]()
           {
-            video_socket.send_to(asio::buffer(std::string("some video")), video_remote_endpoint);
-            sleep(1);
-          }
-        });
+            for (;;)
+            {
+              video_socket.send_to(asio::buffer(std::string("some video")), video_remote_endpoint);
+              clock.sleep_for(1);
+            }
+          });
+      } else {
+        // Loop over the video file, each access unit is split into packets like the drone does
+        video_thread = std::thread(
+          [&video_socket, &video_remote_endpoint, &clock, &access_units]()
+          {
+            for (;;)
+            {
+              for (auto &au : access_units) {
+                for (size_t i = 0; i < au.size(); i += VIDEO_PACKET_SIZE) {
+                  video_socket.send_to(asio::buffer(au.data() + i, std::min(VIDEO_PACKET_SIZE, au.size() - i)),
+                                       video_remote_endpoint);
+                }
+                clock.sleep_for(1 / VIDEO_FPS);
+              }
+            }
+          });
+      }
     }
   }
 }
@@ -107,17 +202,33 @@ int main(int argc, char* argv[])
     unsigned short drone_port = 8889;
     unsigned short data_port = 8890;
     unsigned short video_port = 11111;
+    double time_scale = 1.0;
+    std::vector<std::string> access_units;
 
-    if (argc == 5) {
+    // Usage: tello_emulator [name drone_port data_port video_port [time_scale [video.h264]]]
+    if (argc >= 5 && argc <= 7) {
       name = argv[1];
       drone_port = static_cast<unsigned short>(std::stoi(argv[2]));
       data_port = static_cast<unsigned short>(std::stoi(argv[3]));
       video_port = static_cast<unsigned short>(std::stoi(argv[4]));
     }
 
+    if (argc >= 6) {
+      time_scale = std::stod(argv[5]);
+      if (time_scale <= 0) {
+        throw std::invalid_argument("time_scale must be > 0");
+      }
+    }
+
+    if (argc == 7) {
+      access_units = load_access_units(argv[6]);
+      std::cout << name << " loaded " << access_units.size() << " video frames from " << argv[6] << std::endl;
+    }
+
     std::cout << name << " on 127.0.0.1:" << drone_port
-      << ", data port " << data_port << ", video port " << video_port << std::endl;
-    emulator(false, name, drone_port, data_port, video_port);
+      << ", data port " << data_port << ", video port " << video_port
+      << ", time scale " << time_scale << std::endl;
+    emulator(false, name, drone_port, data_port, video_port, VirtualClock{time_scale}, access_units);
   }
   catch (std::exception& e)
   {
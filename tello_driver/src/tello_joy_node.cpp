@@ -3,7 +3,7 @@
 #include "rclcpp/rclcpp.hpp"
 #include "geometry_msgs/msg/twist.hpp"
 #include "sensor_msgs/msg/joy.hpp"
-#include "tello_msgs/srv/tello_action.hpp"
+#include "tello_msgs/srv/tello_typed_action.hpp"
 
 namespace tello_joy
 {
@@ -15,7 +15,7 @@ namespace tello_joy
 
     joy_sub_ = create_subscription<sensor_msgs::msg::Joy>("joy", 1, std::bind(&TelloJoyNode::joy_callback, this, _1));
     cmd_vel_pub_ = create_publisher<geometry_msgs::msg::Twist>("cmd_vel", 1);
-    tello_client_ = create_client<tello_msgs::srv::TelloAction>("tello_action");
+    tello_client_ = create_client<tello_msgs::srv::TelloTypedAction>("tello_typed_action");
 
     (void) joy_sub_;
   }
@@ -27,12 +27,12 @@ namespace tello_joy
   void TelloJoyNode::joy_callback(const sensor_msgs::msg::Joy::SharedPtr joy_msg)
   {
     if (joy_msg->buttons[joy_button_takeoff_]) {
-      auto request = std::make_shared<tello_msgs::srv::TelloAction::Request>();
-      request->cmd = "takeoff";
+      auto request = std::make_shared<tello_msgs::srv::TelloTypedAction::Request>();
+      request->command.type = request->command.TAKEOFF;
       tello_client_->async_send_request(request);
     } else if (joy_msg->buttons[joy_button_land_]) {
-      auto request = std::make_shared<tello_msgs::srv::TelloAction::Request>();
-      request->cmd = "land";
+      auto request = std::make_shared<tello_msgs::srv::TelloTypedAction::Request>();
+      request->command.type = request->command.LAND;
       tello_client_->async_send_request(request);
     } else {
       geometry_msgs::msg::Twist twist_msg;
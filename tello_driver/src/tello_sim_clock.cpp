@@ -0,0 +1,49 @@
+#include <chrono>
+
+#include "rclcpp/rclcpp.hpp"
+#include "rosgraph_msgs/msg/clock.hpp"
+
+//=====================================================================================
+// Publish /clock running time_scale times faster than real time
+//
+// Use with tello_emulator at the same time scale and tello_driver with use_sim_time,
+// so timing-dependent tests (keep-alive, timeouts) run faster than real time.
+//=====================================================================================
+
+class SimClockNode : public rclcpp::Node
+{
+  rclcpp::Publisher<rosgraph_msgs::msg::Clock>::SharedPtr clock_pub_;
+  rclcpp::TimerBase::SharedPtr timer_;
+  std::chrono::steady_clock::time_point start_;
+  double time_scale_;
+
+public:
+
+  SimClockNode() :
+    Node("tello_sim_clock"), start_(std::chrono::steady_clock::now())
+  {
+    time_scale_ = declare_parameter("time_scale", 1.0);
+    auto period_ms = declare_parameter("period_ms", 5);
+
+    RCLCPP_INFO(get_logger(), "Publishing /clock, time scale %g", time_scale_);
+
+    clock_pub_ = create_publisher<rosgraph_msgs::msg::Clock>("/clock", rclcpp::ClockQoS());
+
+    // Wall timer, this node is the time source
+    timer_ = create_wall_timer(std::chrono::milliseconds(period_ms), [this]()
+    {
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_;
+      rosgraph_msgs::msg::Clock msg;
+      msg.clock = rclcpp::Time(static_cast<int64_t>(elapsed.count() * time_scale_ * 1e9), RCL_ROS_TIME);
+      clock_pub_->publish(msg);
+    });
+  }
+};
+
+int main(int argc, char **argv)
+{
+  rclcpp::init(argc, argv);
+  rclcpp::spin(std::make_shared<SimClockNode>());
+  rclcpp::shutdown();
+  return 0;
+}
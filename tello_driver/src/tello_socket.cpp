@@ -1,32 +1,95 @@
-#include "tello_driver_node.hpp"
+#include "tello_core.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <sys/socket.h>
 
 namespace tello_driver
 {
 
+  TelloSocket::TelloSocket(TelloCore *core, const SocketBinding &binding, unsigned short port) :
+    core_(core), socket_(io_service_)
+  {
+    socket_.open(udp::v4());
+
+    // Must happen before bind, requires CAP_NET_RAW on kernels older than 5.7
+    if (!binding.interface.empty()) {
+      if (setsockopt(socket_.native_handle(), SOL_SOCKET, SO_BINDTODEVICE,
+                     binding.interface.c_str(), binding.interface.size()) < 0) {
+        core_->log(LogLevel::error, "Can't bind port " + std::to_string(port) + " to interface " +
+                                    binding.interface + ": " + strerror(errno));
+      }
+    }
+
+    auto address = binding.address.empty() ? asio::ip::address_v4::any() :
+                   asio::ip::address_v4::from_string(binding.address);
+    socket_.bind(udp::endpoint(address, port));
+  }
+
+  TelloSocket::~TelloSocket()
+  {
+    stop();
+  }
+
+  void TelloSocket::stop()
+  {
+    // shutdown() wakes the receive thread, even on an unconnected UDP socket
+    stopping_ = true;
+    ::shutdown(socket_.native_handle(), SHUT_RDWR);
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
   void TelloSocket::listen()
   {
     thread_ = std::thread(
       [this]()
       {
-        for (;;) {
-          size_t r = socket_.receive(asio::buffer(buffer_));
-          process_packet(r);
+        while (!stopping_) {
+          asio::error_code ec;
+          size_t r = socket_.receive(asio::buffer(buffer_), 0, ec);
+          if (stopping_) {
+            break;
+          }
+          if (!ec) {
+            process_packet(r);
+          }
         }
       });
   }
 
+  bool TelloSocket::note_packet()
+  {
+    receive_time_ = CoreClock::now();
+    packets_++;
+
+    if (!receiving_) {
+      receiving_ = true;
+      return true;
+    }
+    return false;
+  }
+
   bool TelloSocket::receiving()
   {
     std::lock_guard<std::mutex> lock(mtx_);
     return receiving_;
   }
 
-  rclcpp::Time TelloSocket::receive_time()
+  CoreClock::time_point TelloSocket::receive_time()
   {
     std::lock_guard<std::mutex> lock(mtx_);
     return receive_time_;
   }
 
+  uint64_t TelloSocket::packets()
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return packets_;
+  }
+
   void TelloSocket::timeout()
   {
     std::lock_guard<std::mutex> lock(mtx_);
@@ -0,0 +1,360 @@
+#include "tello_driver_node.hpp"
+
+#include <algorithm>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+#include <opencv2/imgcodecs.hpp>
+
+#include "camera_calibration_parsers/parse.hpp"
+
+#include "frame_hub.hpp"
+
+namespace tello_driver
+{
+
+  constexpr double STILL_TIMEOUT = 5;       // Default wait for a keyframe, in seconds
+  constexpr int STILL_JPEG_QUALITY = 90;
+
+  VideoPublisher::VideoPublisher(TelloDriverNode *driver, const VideoConfig &config, const PipelineConfig &pipeline) :
+    driver_(driver),
+    source_(driver->get_fully_qualified_name()),
+    shm_ring_name_(config.shm_ring_name),
+    shm_ring_slots_(config.shm_ring_slots),
+    latest_(av_frame_alloc())
+  {
+    std::string camera_name;
+    if (camera_calibration_parsers::readCalibration(config.camera_info_path, camera_name, camera_info_msg_)) {
+      RCLCPP_INFO(driver_->get_logger(), "Parsed camera info for '%s'", camera_name.c_str());
+    } else {
+      RCLCPP_ERROR(driver_->get_logger(), "Cannot get camera info");
+    }
+
+    pipeline_.convert_stripes = 1;
+    pipeline_.encoding = sensor_msgs::image_encodings::BGR8;
+    set_pipeline(pipeline);
+    apply_pipeline();
+
+    if (config.playout.min_delay > 0) {
+      RCLCPP_INFO(driver_->get_logger(), "Playout delay %gs%s, max %gs", config.playout.min_delay,
+                  config.playout.adaptive ? " or more" : "", config.playout.max_delay);
+      playout_ = std::make_unique<PlayoutBuffer>(config.playout,
+                                                 [this](const AVFrame &frame, PlayoutBuffer::Clock::time_point)
+                                                 {
+                                                   // Without playout the core video thread catches these
+                                                   try {
+                                                     publish_frame(frame);
+                                                   } catch (std::runtime_error &e) {
+                                                     RCLCPP_ERROR(driver_->get_logger(), "%s", e.what());
+                                                   }
+                                                 });
+    }
+
+    still_thread_ = std::thread(&VideoPublisher::run_stills, this);
+  }
+
+  VideoPublisher::~VideoPublisher()
+  {
+    {
+      std::lock_guard<std::mutex> lock(still_mtx_);
+      still_stopping_ = true;
+    }
+    still_cv_.notify_all();
+    still_thread_.join();
+
+    for (auto &job : still_jobs_) {
+      av_frame_free(&job.frame);
+    }
+    av_frame_free(&latest_);
+  }
+
+  bool VideoPublisher::take_playout_stats(PlayoutStats &stats)
+  {
+    if (!playout_) {
+      return false;
+    }
+    stats = playout_->take_stats();
+    return true;
+  }
+
+  void VideoPublisher::set_pipeline(const PipelineConfig &pipeline)
+  {
+    std::atomic_store(&next_pipeline_, std::make_shared<const PipelineConfig>(pipeline));
+  }
+
+  // Switch to the most recent pipeline configuration, called by the video thread between frames
+  // The core applies keyframes_only, this only tracks it
+  void VideoPublisher::apply_pipeline()
+  {
+    auto next = std::atomic_exchange(&next_pipeline_, std::shared_ptr<const PipelineConfig>());
+    if (!next || *next == pipeline_) {
+      return;
+    }
+
+    if (next->convert_stripes != pipeline_.convert_stripes) {
+      RCLCPP_INFO(driver_->get_logger(), "Converting pixels in %d stripes", std::max(1, next->convert_stripes));
+      converter_.set_stripes(next->convert_stripes);
+    }
+
+    if (next->encoding != pipeline_.encoding) {
+      RCLCPP_INFO(driver_->get_logger(), "Publishing %s images", next->encoding.c_str());
+      converter_.set_rgb(next->encoding == sensor_msgs::image_encodings::RGB8);
+    }
+
+    pipeline_ = *next;
+  }
+
+  // Size buffers for a new stream
+  void VideoPublisher::resize_stream(int width, int height)
+  {
+    stream_width_ = width;
+    stream_height_ = height;
+
+    bgr_buffer_.resize(converter_.predict_size(width, height));
+
+    // Readers of a ring with small slots will see that it is closed and re-open it
+    if (!shm_ring_name_.empty() && (!frame_ring_ || frame_ring_->slot_size() < bgr_buffer_.size())) {
+      frame_ring_.reset();
+      try {
+        frame_ring_ = std::make_unique<FrameRingWriter>(shm_ring_name_, shm_ring_slots_, bgr_buffer_.size());
+        RCLCPP_INFO(driver_->get_logger(), "Writing frames to shared memory ring /%s", shm_ring_name_.c_str());
+      } catch (std::runtime_error &e) {
+        RCLCPP_ERROR(driver_->get_logger(), "%s", e.what());
+        shm_ring_name_.clear();
+      }
+    }
+
+    if (camera_info_msg_.width != static_cast<uint32_t>(width) ||
+        camera_info_msg_.height != static_cast<uint32_t>(height)) {
+      RCLCPP_WARN(driver_->get_logger(), "Camera info is for %dx%d, stream is %dx%d",
+                  camera_info_msg_.width, camera_info_msg_.height, width, height);
+    }
+  }
+
+  // Called by the core video thread for each decoded frame
+  void VideoPublisher::on_frame(const AVFrame &frame, CoreClock::time_point time)
+  {
+    {
+      // A reference, not a copy, the decoder's frames are reference counted (refcounted_frames)
+      std::lock_guard<std::mutex> lock(still_mtx_);
+      av_frame_unref(latest_);
+      av_frame_ref(latest_, &frame);
+      latest_time_ = time;
+
+      // Hand the keyframe to the still thread, converting and encoding here would stall decoding
+      if (frame.key_frame && !still_waiters_.empty()) {
+        for (auto &waiter : still_waiters_) {
+          still_jobs_.push_back(StillJob{waiter.request, waiter.respond, av_frame_clone(&frame), time});
+        }
+        still_waiters_.clear();
+        still_cv_.notify_one();
+      }
+    }
+
+    // In-process consumers such as the mosaic take a reference, ahead of the playout delay
+    auto &hub = FrameHub::instance();
+    if (hub.wanted()) {
+      hub.publish(source_, frame);
+    }
+
+    if (playout_) {
+      playout_->push(frame, time);
+    } else {
+      publish_frame(frame);
+    }
+  }
+
+  // Called by the core video thread, or by the playout thread if playout is enabled
+  void VideoPublisher::publish_frame(const AVFrame &frame)
+  {
+    apply_pipeline();
+
+    if (frame.width != stream_width_ || frame.height != stream_height_) {
+      resize_stream(frame.width, frame.height);
+    }
+
+    // Synchronize ROS messages
+    auto stamp = driver_->now();
+
+    // Decide what to publish before doing any pixel or message work
+    bool publish_image = driver_->count_subscribers(driver_->image_pub_->get_topic_name()) > 0 &&
+                         driver_->image_governor_.ready(stamp);
+    bool publish_gray = driver_->count_subscribers(driver_->image_gray_pub_->get_topic_name()) > 0 &&
+                        driver_->image_gray_governor_.ready(stamp);
+    bool publish_camera_info = driver_->count_subscribers(driver_->camera_info_pub_->get_topic_name()) > 0 &&
+                               driver_->camera_info_governor_.ready(stamp);
+
+    // Convert pixels from YUV420P to BGR24 only if someone takes them, straight into the shared memory ring if
+    // there is one
+    if (publish_image || frame_ring_) {
+      unsigned char *bgr24 = frame_ring_ ? frame_ring_->begin_write() : bgr_buffer_.data();
+      converter_.convert(frame, bgr24);
+
+      if (frame_ring_) {
+        frame_ring_->end_write(frame.width, frame.height, frame.width * 3, pipeline_.encoding,
+                               stamp.nanoseconds());
+      }
+
+      if (publish_image) {
+        std_msgs::msg::Header header{};
+        header.frame_id = "camera_frame";
+        header.stamp = stamp;
+        cv::Mat mat{frame.height, frame.width, CV_8UC3, bgr24};
+        cv_bridge::CvImage cv_image{header, pipeline_.encoding, mat};
+        sensor_msgs::msg::Image sensor_image_msg;
+        cv_image.toImageMsg(sensor_image_msg);
+        driver_->image_pub_->publish(sensor_image_msg);
+      }
+    }
+
+    // The Y plane is a grayscale image, publish it as a unique_ptr so intra-process subscribers take ownership
+    if (publish_gray) {
+      auto gray_msg = std::make_unique<sensor_msgs::msg::Image>();
+      gray_msg->header.frame_id = "camera_frame";
+      gray_msg->header.stamp = stamp;
+      gray_msg->height = frame.height;
+      gray_msg->width = frame.width;
+      gray_msg->encoding = sensor_msgs::image_encodings::MONO8;
+      gray_msg->step = frame.width;
+      gray_msg->data.resize(static_cast<size_t>(frame.width) * frame.height);
+      for (int row = 0; row < frame.height; ++row) {
+        const uint8_t *y_row = frame.data[0] + row * frame.linesize[0];
+        std::copy(y_row, y_row + frame.width, gray_msg->data.begin() + row * frame.width);
+      }
+      driver_->image_gray_pub_->publish(std::move(gray_msg));
+    }
+
+    if (publish_camera_info) {
+      camera_info_msg_.header.stamp = stamp;
+      driver_->camera_info_pub_->publish(camera_info_msg_);
+    }
+  }
+
+  void VideoPublisher::capture_still(StillRequest request, StillRespond respond)
+  {
+    auto response = std::make_shared<tello_msgs::srv::TelloCaptureStill::Response>();
+
+    if (request->format != request->RAW && request->format != request->JPEG) {
+      response->rc = response->ERROR_INVALID;
+      respond(response);
+      return;
+    }
+
+    if (request->wait_keyframe) {
+      double timeout = request->timeout > 0 ? request->timeout : STILL_TIMEOUT;
+      auto deadline = CoreClock::now() + std::chrono::duration_cast<CoreClock::duration>(
+        std::chrono::duration<double>(timeout));
+      std::lock_guard<std::mutex> lock(still_mtx_);
+      still_waiters_.push_back(StillWaiter{request, respond, deadline});
+      return;
+    }
+
+    // Take another reference, so the video thread can move on while we convert
+    AVFrame *frame = nullptr;
+    CoreClock::time_point time;
+    {
+      std::lock_guard<std::mutex> lock(still_mtx_);
+      if (latest_->data[0]) {
+        frame = av_frame_clone(latest_);
+        time = latest_time_;
+      }
+    }
+
+    if (!frame) {
+      response->rc = response->ERROR_NOT_AVAILABLE;
+      respond(response);
+      return;
+    }
+
+    convert_still(request, *frame, time, respond);
+    av_frame_free(&frame);
+  }
+
+  void VideoPublisher::expire_stills()
+  {
+    std::vector<StillWaiter> expired;
+    auto now = CoreClock::now();
+
+    {
+      std::lock_guard<std::mutex> lock(still_mtx_);
+      auto i = std::partition(still_waiters_.begin(), still_waiters_.end(),
+                              [now](const StillWaiter &waiter) { return waiter.deadline > now; });
+      expired.assign(i, still_waiters_.end());
+      still_waiters_.erase(i, still_waiters_.end());
+    }
+
+    for (const auto &waiter : expired) {
+      auto response = std::make_shared<tello_msgs::srv::TelloCaptureStill::Response>();
+      response->rc = response->ERROR_TIMEOUT;
+      waiter.respond(response);
+    }
+  }
+
+  void VideoPublisher::run_stills()
+  {
+    std::unique_lock<std::mutex> lock(still_mtx_);
+
+    while (true) {
+      still_cv_.wait(lock, [this] { return still_stopping_ || !still_jobs_.empty(); });
+      if (still_stopping_) {
+        return;
+      }
+
+      StillJob job = std::move(still_jobs_.front());
+      still_jobs_.pop_front();
+      lock.unlock();
+
+      if (job.frame) {
+        convert_still(job.request, *job.frame, job.time, job.respond);
+        av_frame_free(&job.frame);
+      } else {
+        auto response = std::make_shared<tello_msgs::srv::TelloCaptureStill::Response>();
+        response->rc = response->ERROR_NOT_AVAILABLE;
+        job.respond(response);
+      }
+
+      lock.lock();
+    }
+  }
+
+  // Convert one frame, on the caller's thread
+  void VideoPublisher::convert_still(const StillRequest &request, const AVFrame &frame, CoreClock::time_point time,
+                                     const StillRespond &respond)
+  {
+    auto response = std::make_shared<tello_msgs::srv::TelloCaptureStill::Response>();
+
+    // Stamp with the decode time in ROS time
+    auto stamp = driver_->now() - rclcpp::Duration(CoreClock::now() - time);
+
+    {
+      std::lock_guard<std::mutex> lock(still_convert_mtx_);
+
+      if (request->format == request->RAW) {
+        auto &image = response->image;
+        image.header.frame_id = "camera_frame";
+        image.header.stamp = stamp;
+        image.height = frame.height;
+        image.width = frame.width;
+        image.encoding = sensor_msgs::image_encodings::BGR8;
+        image.step = frame.width * 3;
+        image.data.resize(still_converter_.predict_size(frame.width, frame.height));
+        still_converter_.convert(frame, image.data.data());
+      } else {
+        still_buffer_.resize(still_converter_.predict_size(frame.width, frame.height));
+        still_converter_.convert(frame, still_buffer_.data());
+        cv::Mat mat{frame.height, frame.width, CV_8UC3, still_buffer_.data()};
+
+        int quality = request->jpeg_quality > 0 ? std::min(100, request->jpeg_quality) : STILL_JPEG_QUALITY;
+        response->jpeg.header.frame_id = "camera_frame";
+        response->jpeg.header.stamp = stamp;
+        response->jpeg.format = "jpeg";
+        cv::imencode(".jpg", mat, response->jpeg.data, {cv::IMWRITE_JPEG_QUALITY, quality});
+      }
+    }
+
+    response->rc = response->OK;
+    respond(response);
+  }
+
+} // namespace tello_driver
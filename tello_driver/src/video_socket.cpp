@@ -1,56 +1,90 @@
-#include "tello_driver_node.hpp"
+#include "tello_core.hpp"
 
 #include <libavutil/frame.h>
-#include <opencv2/highgui.hpp>
-
-#include "camera_calibration_parsers/parse.hpp"
 
 namespace tello_driver
 {
 
+  constexpr size_t RECEIVE_BUFFER_SIZE = 65536;         // Max UDP payload
+  constexpr size_t DEFAULT_PACKET_SIZE = 1460;          // Tello packet size
+  constexpr int PACKET_SIZE_RUN = 8;                    // Shrink packet_size_ after this many equal, smaller packets
+  constexpr size_t MIN_SEQ_BUFFER_SIZE = 65536;         // Enough for a 960x720 keyframe
+  constexpr size_t MAX_SEQ_BUFFER_SIZE = 8 * 1024 * 1024;
+
   // Notes on Tello video:
-  // -- frames are always 960x720.
-  // -- frames are split into UDP packets of length 1460.
+  // -- frames are 960x720 by default, SDK 3.0 drones can also send 1280x720 (setresolution).
+  // -- frames are split into UDP packets of length 1460 (we track the largest packet seen, just in case,
+  //    and shrink back if a run of equal, smaller packets shows that it was a stray or the stream changed).
   // -- normal frames are ~10k, or about 8 UDP packets.
   // -- keyframes are ~35k, or about 25 UDP packets.
   // -- keyframes are always preceded by an 8-byte UDP packet and a 13-byte UDP packet -- markers?
   // -- the h264 parser will consume the 8-byte packet, the 13-byte packet and the entire keyframe without
   //    generating a frame. Presumably the keyframe is stored in the parser and referenced later.
 
-  VideoSocket::VideoSocket(TelloDriverNode *driver, unsigned short video_port, const std::string &camera_info_path) :
-    TelloSocket(driver, video_port)
+  VideoSocket::VideoSocket(TelloCore *core, const SocketBinding &binding, unsigned short video_port) :
+    TelloSocket(core, binding, video_port),
+    packet_size_(DEFAULT_PACKET_SIZE)
   {
-    std::string camera_name;
-    if (camera_calibration_parsers::readCalibration(camera_info_path, camera_name, camera_info_msg_)) {
-      RCLCPP_INFO(driver_->get_logger(), "Parsed camera info for '%s'", camera_name.c_str());
-    } else {
-      RCLCPP_ERROR(driver_->get_logger(), "Cannot get camera info");
-    }
-
-    buffer_ = std::vector<unsigned char>(2048);
-    seq_buffer_ = std::vector<unsigned char>(65536);
+    buffer_ = std::vector<unsigned char>(RECEIVE_BUFFER_SIZE);
+    seq_buffer_ = std::vector<unsigned char>(MIN_SEQ_BUFFER_SIZE);
     listen();
   }
 
+  VideoStats VideoSocket::take_stats()
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    VideoStats stats = stats_;
+    stats_ = VideoStats{};
+    return stats;
+  }
+
+  void VideoSocket::set_keyframes_only(bool keyframes_only)
+  {
+    next_keyframes_only_ = keyframes_only;
+  }
+
   // Process a video packet from the drone
+  // The sequence buffer and decoder are only used by this thread, mtx_ guards the rest
   void VideoSocket::process_packet(size_t r)
   {
-    std::lock_guard<std::mutex> lock(mtx_);
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+
+      if (note_packet()) {
+        // First packet
+        core_->log(LogLevel::info, "Receiving video");
+        seq_buffer_next_ = 0;
+        seq_buffer_num_packets_ = 0;
+        packet_size_ = DEFAULT_PACKET_SIZE;
+        run_size_ = 0;
+        run_length_ = 0;
+      }
 
-    receive_time_ = driver_->now();
+      stats_.packets++;
+    }
 
-    if (!receiving_) {
-      // First packet
-      RCLCPP_INFO(driver_->get_logger(), "Receiving video");
-      receiving_ = true;
-      seq_buffer_next_ = 0;
-      seq_buffer_num_packets_ = 0;
+    // Grow the sequence buffer between sequences, never while the decoder is using it
+    if (seq_buffer_next_ == 0 && seq_buffer_wanted_ > seq_buffer_.size()) {
+      core_->log(LogLevel::info, "Video sequence buffer is now " + std::to_string(seq_buffer_wanted_) + " bytes");
+      seq_buffer_.resize(seq_buffer_wanted_);
     }
 
     if (seq_buffer_next_ + r >= seq_buffer_.size()) {
-      RCLCPP_ERROR(driver_->get_logger(), "Video buffer overflow, dropping sequence");
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stats_.sequences++;
+        stats_.dropped++;
+      }
       seq_buffer_next_ = 0;
       seq_buffer_num_packets_ = 0;
+
+      if (seq_buffer_.size() < MAX_SEQ_BUFFER_SIZE) {
+        // Larger stream than expected, make room for the next sequence
+        seq_buffer_wanted_ = std::min(MAX_SEQ_BUFFER_SIZE, 2 * seq_buffer_.size());
+        core_->log(LogLevel::warn, "Video buffer overflow, dropping sequence and growing buffer");
+      } else {
+        core_->log(LogLevel::error, "Video buffer overflow, dropping sequence");
+      }
       return;
     }
 
@@ -58,8 +92,21 @@ namespace tello_driver
     seq_buffer_next_ += r;
     seq_buffer_num_packets_++;
 
-    // If the packet is < 1460 bytes then it's the last packet in the sequence
-    if (r < 1460) {
+    if (r == run_size_) {
+      run_length_++;
+    } else {
+      run_size_ = r;
+      run_length_ = 1;
+    }
+
+    // Last packets vary in size, full packets don't
+    if (r > packet_size_ || (r < packet_size_ && run_length_ >= PACKET_SIZE_RUN)) {
+      core_->log(LogLevel::info, "Video packet size is now " + std::to_string(r) + " bytes");
+      packet_size_ = r;
+    }
+
+    // If the packet is short then it's the last packet in the sequence
+    if (r < packet_size_) {
       decode_frames();
 
       seq_buffer_next_ = 0;
@@ -67,58 +114,85 @@ namespace tello_driver
     }
   }
 
+  // Size buffers for a new stream, called when the parser sees an SPS with new dimensions
+  void VideoSocket::resize_stream(int width, int height)
+  {
+    core_->log(LogLevel::info, "Video stream is " + std::to_string(width) + "x" + std::to_string(height));
+    stream_width_ = width;
+    stream_height_ = height;
+
+    // Keyframes are much smaller than w * h / 4, so this leaves plenty of room
+    size_t wanted = std::min(MAX_SEQ_BUFFER_SIZE, static_cast<size_t>(width) * height / 4);
+    if (wanted > seq_buffer_.size() && wanted > seq_buffer_wanted_) {
+      seq_buffer_wanted_ = wanted;
+    }
+  }
+
   // Decode frames
   void VideoSocket::decode_frames()
   {
     size_t next = 0;
+    VideoStats stats;
+
+    stats.sequences++;
+
+    // Sequences start on a frame boundary
+    bool keyframes_only = next_keyframes_only_;
+    if (keyframes_only != keyframes_only_) {
+      core_->log(LogLevel::info, keyframes_only ? "Decoding keyframes only" : "Decoding all frames");
+      decoder_.set_keyframes_only(keyframes_only);
+      keyframes_only_ = keyframes_only;
+    }
 
     try {
       while (next < seq_buffer_next_) {
         // Parse h264
         ssize_t consumed = decoder_.parse(seq_buffer_.data() + next, seq_buffer_next_ - next);
 
-        // Is a frame available?
-        if (decoder_.is_frame_available()) {
+        // New stream parameters?
+        if (decoder_.stream_width() > 0 &&
+            (decoder_.stream_width() != stream_width_ || decoder_.stream_height() != stream_height_)) {
+          resize_stream(decoder_.stream_width(), decoder_.stream_height());
+        }
+
+        // Recorders get every frame, even frames that aren't decoded
+        if (decoder_.is_frame_available() && core_->callbacks().access_unit) {
+          AccessUnit au{decoder_.packet_data(), static_cast<size_t>(decoder_.packet_size()), decoder_.is_keyframe(),
+                        stream_width_, stream_height_};
+          core_->callbacks().access_unit(au, CoreClock::now());
+        }
+
+        // Skip frames that depend on other frames, the decoder never sees them
+        if (keyframes_only_ && decoder_.is_frame_available() && !decoder_.is_keyframe()) {
+          stats.skipped++;
+        } else if (decoder_.is_frame_available()) {
           // Decode the frame
           const AVFrame &frame = decoder_.decode_frame();
+          stats.frames++;
 
-          // Convert pixels from YUV420P to BGR24
-          int size = converter_.predict_size(frame.width, frame.height);
-          unsigned char bgr24[size];
-          converter_.convert(frame, bgr24);
-
-          // Convert to cv::Mat
-          cv::Mat mat{frame.height, frame.width, CV_8UC3, bgr24};
-
-          // Display
-          cv::imshow("frame", mat);
-          cv::waitKey(1);
-
-          // Synchronize ROS messages
-          auto stamp = driver_->now();
-
-          if (driver_->count_subscribers(driver_->image_pub_->get_topic_name()) > 0) {
-            std_msgs::msg::Header header{};
-            header.frame_id = "camera_frame";
-            header.stamp = stamp;
-            cv_bridge::CvImage cv_image{header, sensor_msgs::image_encodings::BGR8, mat};
-            sensor_msgs::msg::Image sensor_image_msg;
-            cv_image.toImageMsg(sensor_image_msg);
-            driver_->image_pub_->publish(sensor_image_msg);
+          // The SPS and the frame should agree, but don't trust that
+          if (frame.width != stream_width_ || frame.height != stream_height_) {
+            resize_stream(frame.width, frame.height);
           }
 
-          if (driver_->count_subscribers(driver_->camera_info_pub_->get_topic_name()) > 0) {
-            camera_info_msg_.header.stamp = stamp;
-            driver_->camera_info_pub_->publish(camera_info_msg_);
+          if (core_->callbacks().frame) {
+            core_->callbacks().frame(frame, CoreClock::now());
           }
         }
 
         next += consumed;
       }
     }
-    catch (std::runtime_error e) {
-      RCLCPP_ERROR(driver_->get_logger(), e.what());
+    catch (std::runtime_error &e) {
+      stats.errors++;
+      core_->log(LogLevel::error, e.what());
     }
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    stats_.sequences += stats.sequences;
+    stats_.frames += stats.frames;
+    stats_.skipped += stats.skipped;
+    stats_.errors += stats.errors;
   }
 
-} // namespace tello_driver
\ No newline at end of file
+} // namespace tello_driver
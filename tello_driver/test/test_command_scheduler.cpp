@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "command_scheduler.hpp"
+
+using tello_driver::CommandScheduler;
+
+constexpr int64_t MS = 1000000;
+constexpr int64_t TOLERANCE_NS = 20 * MS;       // Generous, the test may not run at a real-time priority
+
+// Schedule fire() at target_ns, record the time it fired in actual_ns
+static void schedule_at(const void *owner, int64_t target_ns, std::atomic<int64_t> &actual_ns)
+{
+  CommandScheduler::instance().schedule(owner, target_ns, [&actual_ns]()
+  {
+    actual_ns = CommandScheduler::now_ns();
+    return true;
+  }, nullptr);
+}
+
+// A near entry scheduled after a far one must not wait for the far one
+TEST(CommandScheduler, NearAfterFar)
+{
+  int far_owner, near_owner;
+  std::atomic<int64_t> a{0}, b{0}, c{0};
+
+  int64_t start = CommandScheduler::now_ns();
+  schedule_at(&far_owner, start + 1000 * MS, a);
+  schedule_at(&near_owner, start + 100 * MS, b);
+  schedule_at(&near_owner, start + 300 * MS, c);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(400));
+
+  ASSERT_NE(b, 0);
+  ASSERT_NE(c, 0);
+  EXPECT_LT(b - (start + 100 * MS), TOLERANCE_NS);
+  EXPECT_LT(c - (start + 300 * MS), TOLERANCE_NS);
+
+  // The far entry is still pending, cancel() must not wait for it
+  int64_t cancel_start = CommandScheduler::now_ns();
+  CommandScheduler::instance().cancel(&far_owner);
+  EXPECT_LT(CommandScheduler::now_ns() - cancel_start, TOLERANCE_NS);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(800));
+  EXPECT_EQ(a, 0);
+}
+
+// Entries are fired in target order, late entries fire right away
+TEST(CommandScheduler, Order)
+{
+  int owner;
+  std::atomic<int64_t> late{0}, first{0}, second{0};
+
+  int64_t start = CommandScheduler::now_ns();
+  schedule_at(&owner, start + 60 * MS, second);
+  schedule_at(&owner, start + 30 * MS, first);
+  schedule_at(&owner, start - 10 * MS, late);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  ASSERT_NE(late, 0);
+  ASSERT_NE(first, 0);
+  ASSERT_NE(second, 0);
+  EXPECT_LT(late - start, TOLERANCE_NS);
+  EXPECT_GE(first, start + 30 * MS);
+  EXPECT_GE(second, start + 60 * MS);
+  EXPECT_LT(first, second);
+}
+
+// A swarm of 20 drivers at one target, the goal is all 20 sends within 100us of each other
+// Only the generous tolerance is checked, the spread is reported for runs on a quiet machine
+TEST(CommandScheduler, Swarm)
+{
+  constexpr int OWNERS = 20;
+  constexpr int ROUNDS = 10;
+
+  std::vector<int> owners(OWNERS);
+  int64_t worst_spread = 0;
+  int64_t worst_error = 0;
+
+  for (int round = 0; round < ROUNDS; ++round) {
+    std::vector<std::atomic<int64_t>> actual(OWNERS);
+    int64_t target = CommandScheduler::now_ns() + 20 * MS;
+
+    for (int i = 0; i < OWNERS; ++i) {
+      actual[i] = 0;
+      schedule_at(&owners[i], target, actual[i]);
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    int64_t first = INT64_MAX, last = INT64_MIN;
+    for (int i = 0; i < OWNERS; ++i) {
+      ASSERT_NE(actual[i], 0);
+      first = std::min(first, actual[i] - target);
+      last = std::max(last, actual[i] - target);
+    }
+
+    EXPECT_GE(first, 0);
+    worst_spread = std::max(worst_spread, last - first);
+    worst_error = std::max(worst_error, last);
+  }
+
+  EXPECT_LT(worst_spread, TOLERANCE_NS);
+  RecordProperty("worst_spread_ns", static_cast<int>(worst_spread));
+  RecordProperty("worst_error_ns", static_cast<int>(worst_error));
+  std::printf("%d owners, %d rounds: worst error_ns spread %ld, worst error_ns %ld\n", OWNERS, ROUNDS,
+              static_cast<long>(worst_spread), static_cast<long>(worst_error));
+}
@@ -14,7 +14,6 @@ def generate_launch_description():
     drones = ['drone1']
 
     tello_gazebo_path = get_package_share_directory('tello_gazebo')
-    tello_description_path = get_package_share_directory('tello_description')
 
     world_path = os.path.join(tello_gazebo_path, 'worlds', 'fiducial.world')
     map_path = os.path.join(tello_gazebo_path, 'worlds', 'fiducial_map.yaml')
@@ -48,16 +47,16 @@ def generate_launch_description():
              namespace=drones[0]),
     ]
 
+    # Add all drones to the simulation in one batch
+    entities.append(
+        Node(package='tello_gazebo', executable='spawn_swarm.py', output='screen',
+             arguments=['%s:0:%d:1:0' % (namespace, idx) for idx, namespace in enumerate(drones)]))
+
     # Per-drone entities
     for idx, namespace in enumerate(drones):
         suffix = '_' + str(idx + 1)
-        urdf_path = os.path.join(tello_description_path, 'urdf', 'tello' + suffix + '.urdf')
 
         entities.extend([
-            # Add a drone to the simulation
-            Node(package='tello_gazebo', executable='inject_entity.py', output='screen',
-                 arguments=[urdf_path, '0', str(idx), '1', '0']),
-
             # Localize this drone against the map
             Node(package='fiducial_vlam', executable='vloc_main', output='screen',
                  name='vloc_main', namespace=namespace, parameters=[{
@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+
+"""
+Spawn many Tello drones into Gazebo in one batch
+
+Generate each URDF from the tello_description template in memory, pause physics, send all of the
+SpawnEntity requests at once, wait for them to complete, then unpause physics.
+This is much faster than running inject_entity.py once per drone.
+
+Usage:
+    ros2 run tello_gazebo spawn_swarm.py -- ns:x:y:z:yaw [ns:x:y:z:yaw ...]
+    ros2 run tello_gazebo spawn_swarm.py -- --count 30 [--spacing 1.0] [--z 1.0]
+        [--camera_width 960] [--camera_height 720] [--camera_rate 30]
+
+Drone n (1-based) gets namespace ns (default 'droneN') and frame suffix _N, same as tello_N.urdf.
+"""
+
+import argparse
+import math
+import os
+import sys
+import time
+from typing import Dict, List, Tuple
+
+import rclpy
+import transformations
+from ament_index_python.packages import get_package_share_directory
+from gazebo_msgs.srv import SpawnEntity
+from geometry_msgs.msg import Pose
+from rclpy.utilities import remove_ros_args
+from std_srvs.srv import Empty
+
+Drone = Tuple[str, float, float, float, float]  # namespace, x, y, z, yaw
+
+
+def replace(s: str, d: Dict[str, str]) -> str:
+    """Replace strings like ${key} with a value, same as tello_description/src/replace.py"""
+    for k, v in d.items():
+        s = s.replace('${' + k + '}', v)
+    return s
+
+
+def make_pose(x: float, y: float, z: float, yaw: float) -> Pose:
+    p = Pose()
+    p.position.x = x
+    p.position.y = y
+    p.position.z = z
+    q = transformations.quaternion_from_euler(0, 0, yaw)
+    p.orientation.w = q[0]
+    p.orientation.x = q[1]
+    p.orientation.y = q[2]
+    p.orientation.z = q[3]
+    return p
+
+
+def parse_drones(args) -> List[Drone]:
+    if args.count > 0:
+        # Square grid, facing +x
+        side = math.ceil(math.sqrt(args.count))
+        return [('drone%d' % (i + 1), (i // side) * args.spacing, (i % side) * args.spacing, args.z, 0.0)
+                for i in range(args.count)]
+
+    drones = []
+    for spec in args.drones:
+        fields = spec.split(':')
+        if len(fields) != 5:
+            raise ValueError('expected ns:x:y:z:yaw, got %r' % spec)
+        drones.append((fields[0], float(fields[1]), float(fields[2]), float(fields[3]), float(fields[4])))
+    return drones
+
+
+def call(node, client, request, timeout_sec=None):
+    """Call a service and wait for the response"""
+    if not client.service_is_ready():
+        node.get_logger().info('waiting for %s service...' % client.srv_name)
+        client.wait_for_service()
+    future = client.call_async(request)
+    rclpy.spin_until_future_complete(node, future, timeout_sec=timeout_sec)
+    return future.result()
+
+
+def spawn_swarm(template: str, drones: List[Drone], camera: Dict[str, str], timeout_sec: float):
+    rclpy.init()
+    node = rclpy.create_node('spawn_swarm_node')
+    spawn_client = node.create_client(SpawnEntity, 'spawn_entity')
+    pause_client = node.create_client(Empty, 'pause_physics')
+    unpause_client = node.create_client(Empty, 'unpause_physics')
+
+    start = time.monotonic()
+    call(node, pause_client, Empty.Request())
+
+    try:
+        if not spawn_client.service_is_ready():
+            node.get_logger().info('waiting for spawn_entity service...')
+            spawn_client.wait_for_service()
+
+        # Send all requests, Gazebo inserts the models while physics is paused
+        futures = []
+        for index, (ns, x, y, z, yaw) in enumerate(drones):
+            suffix = '_%d' % (index + 1)
+            request = SpawnEntity.Request()
+            request.name = 'tello' + suffix
+            request.xml = replace(template, dict(camera, suffix=suffix, topic_ns=ns))
+            request.initial_pose = make_pose(x, y, z, yaw)
+            futures.append((ns, spawn_client.call_async(request)))
+
+        deadline = time.monotonic() + timeout_sec
+        while rclpy.ok() and time.monotonic() < deadline and not all(f.done() for _, f in futures):
+            rclpy.spin_once(node, timeout_sec=0.1)
+
+        failed = 0
+        for ns, future in futures:
+            result = future.result() if future.done() else None
+            if result is None or not result.success:
+                failed += 1
+                node.get_logger().error('failed to spawn %s: %r' % (ns, result.status_message if result else 'timeout'))
+
+        node.get_logger().info('spawned %d of %d drones in %.1f seconds' %
+                               (len(drones) - failed, len(drones), time.monotonic() - start))
+    finally:
+        call(node, unpause_client, Empty.Request())
+        node.destroy_node()
+        rclpy.shutdown()
+
+    return failed == 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Spawn many Tello drones into Gazebo in one physics pause')
+    parser.add_argument('drones', nargs='*', help='ns:x:y:z:yaw for each drone')
+    parser.add_argument('--count', type=int, default=0, help='spawn this many drones on a grid instead')
+    parser.add_argument('--spacing', type=float, default=1.0, help='grid spacing, meters')
+    parser.add_argument('--z', type=float, default=1.0, help='grid height, meters')
+    parser.add_argument('--template', default=os.path.join(
+        get_package_share_directory('tello_description'), 'urdf', 'tello.xml'), help='URDF template')
+    parser.add_argument('--camera_width', type=int, default=960, help='camera width, pixels')
+    parser.add_argument('--camera_height', type=int, default=720, help='camera height, pixels')
+    parser.add_argument('--camera_rate', type=float, default=30.0, help='camera render rate, 0 to disable')
+    parser.add_argument('--timeout', type=float, default=60.0, help='seconds to wait for all drones')
+
+    # Ignore ROS arguments added by launch
+    args = parser.parse_args(remove_ros_args(sys.argv)[1:])
+
+    drones = parse_drones(args)
+    if not drones:
+        parser.print_usage()
+        sys.exit(1)
+
+    with open(args.template, 'r') as f:
+        template = f.read()
+
+    camera = {
+        'camera_width': str(args.camera_width),
+        'camera_height': str(args.camera_height),
+        'camera_rate': str(args.camera_rate),
+    }
+
+    sys.exit(0 if spawn_swarm(template, drones, camera, args.timeout) else 1)
+
+
+if __name__ == '__main__':
+    main()
@@ -2,12 +2,14 @@
 
 #include "gazebo/gazebo.hh"
 #include "gazebo/physics/physics.hh"
+#include "gazebo/sensors/sensors.hh"
 
 #include "gazebo_ros/node.hpp"
 #include "geometry_msgs/msg/twist.hpp"
 #include "tello_msgs/msg/flight_data.hpp"
 #include "tello_msgs/msg/tello_response.hpp"
 #include "tello_msgs/srv/tello_action.hpp"
+#include "tello_msgs/srv/tello_typed_action.hpp"
 
 #include "pid.hpp"
 
@@ -17,8 +19,10 @@ using namespace std::chrono_literals;
 // TelloPlugin features:
 // -- generates trivial flight data at 10Hz
 // -- video is managed by a gazebo_ros_pkgs plugin, see tello_description/urdf/tello.xml
+// -- the camera sensor only renders if there are image_raw or camera_info subscribers
 // -- responds to "takeoff" and "land" commands
-// -- responds to cmd_vel and "rc x y z yaw" commands
+// -- responds to cmd_vel and "rc lr fb ud yaw" commands
+// -- responds to typed takeoff, land, stop and rc commands on tello_typed_action, no parsing
 // -- battery state
 //
 // Tello flight dynamics are sophisticated and difficult to model. TelloPlugin keeps it simple:
@@ -81,6 +85,11 @@ namespace tello_gazebo
     ignition::math::Vector3d center_of_mass_{0, 0, 0};
     int battery_duration_{BATTERY_DURATION};
 
+    // Camera sensor, activated only while someone subscribes to its topics
+    std::string camera_sensor_name_;
+    gazebo::sensors::SensorPtr camera_sensor_;
+    bool camera_active_{true};
+
     // Connection to Gazebo message bus
     gazebo::event::ConnectionPtr update_connection_;
 
@@ -93,6 +102,7 @@ namespace tello_gazebo
 
     // ROS services
     rclcpp::Service<tello_msgs::srv::TelloAction>::SharedPtr command_srv_;
+    rclcpp::Service<tello_msgs::srv::TelloTypedAction>::SharedPtr typed_command_srv_;
 
     // ROS subscriptions
     rclcpp::Subscription<geometry_msgs::msg::Twist>::SharedPtr cmd_vel_sub_;
@@ -115,6 +125,7 @@ namespace tello_gazebo
     {
       (void) update_connection_;
       (void) command_srv_;
+      (void) typed_command_srv_;
       (void) cmd_vel_sub_;
 
       transition(FlightState::landed);
@@ -132,21 +143,32 @@ namespace tello_gazebo
       yaw_controller_.set_target(yaw);
     }
 
-    // Respond to a command of the form "rc x y z yaw"
+    // Tello rc stick positions in [-100, 100]: right, forward, up, clockwise
+    // The model is forward, left, up, counterclockwise
+    void set_rc(double lr, double fb, double ud, double yaw)
+    {
+      set_target_velocities(
+        fb / 100.0 * MAX_XY_V,
+        -lr / 100.0 * MAX_XY_V,
+        ud / 100.0 * MAX_Z_V,
+        -yaw / 100.0 * MAX_ANG_V);
+    }
+
+    // Respond to a command of the form "rc lr fb ud yaw"
     void set_target_velocities(std::string rc_command)
     {
-      double x, y, z, yaw;
+      double lr, fb, ud, yaw;
 
       try {
         std::istringstream iss(rc_command, std::istringstream::in);
         std::string s;
         iss >> s; // "rc"
         iss >> s;
-        x = std::stof(s);
+        lr = std::stof(s);
         iss >> s;
-        y = std::stof(s);
+        fb = std::stof(s);
         iss >> s;
-        z = std::stof(s);
+        ud = std::stof(s);
         iss >> s;
         yaw = std::stof(s);
       } catch (std::exception e) {
@@ -154,11 +176,7 @@ namespace tello_gazebo
         return;
       }
 
-      set_target_velocities(
-        x * MAX_XY_V,
-        y * MAX_XY_V,
-        z * MAX_Z_V,
-        yaw * MAX_ANG_V);
+      set_rc(lr, fb, ud, yaw);
     }
 
     void transition(FlightState next)
@@ -204,6 +222,9 @@ namespace tello_gazebo
       if (sdf->HasElement("battery_duration")) {
         battery_duration_ = sdf->GetElement("center_of_mass")->Get<int>();
       }
+      if (sdf->HasElement("camera_sensor")) {
+        camera_sensor_name_ = sdf->GetElement("camera_sensor")->Get<std::string>();
+      }
 
       base_link_ = model->GetLink(link_name);
       GZ_ASSERT(base_link_ != nullptr, "Missing link");
@@ -218,6 +239,7 @@ namespace tello_gazebo
       std::cout << "center_of_mass: " << center_of_mass_ << std::endl;
       std::cout << "gravity: " << gravity_ << std::endl;
       std::cout << "battery_duration: " << battery_duration_ << std::endl;
+      std::cout << "camera_sensor: " << camera_sensor_name_ << std::endl;
       std::cout << "-----------------------------------------" << std::endl;
       std::cout << std::endl;
 
@@ -241,6 +263,9 @@ namespace tello_gazebo
                                                                                    std::placeholders::_1,
                                                                                    std::placeholders::_2,
                                                                                    std::placeholders::_3));
+      typed_command_srv_ = node_->create_service<tello_msgs::srv::TelloTypedAction>(
+        "tello_typed_action", std::bind(&TelloPlugin::typed_command_callback, this,
+                                        std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
 
       // ROS subscription
       cmd_vel_sub_ = node_->create_subscription<geometry_msgs::msg::Twist>("cmd_vel", 10,
@@ -336,6 +361,37 @@ namespace tello_gazebo
       }
     }
 
+    // Typed commands, the arguments are already numbers
+    void typed_command_callback(
+      const std::shared_ptr<rmw_request_id_t> request_header,
+      const std::shared_ptr<tello_msgs::srv::TelloTypedAction::Request> request,
+      std::shared_ptr<tello_msgs::srv::TelloTypedAction::Response> response)
+    {
+      const auto &command = request->command;
+
+      if (command.type == command.TAKEOFF && flight_state_ == FlightState::landed) {
+        transition(FlightState::taking_off);
+        response->rc = response->OK;
+      } else if (command.type == command.LAND && flight_state_ == FlightState::flying) {
+        transition(FlightState::landing);
+        response->rc = response->OK;
+      } else if (command.type == command.STOP && flight_state_ == FlightState::flying) {
+        set_target_velocities(0, 0, 0, 0);
+        response->rc = response->OK;
+      } else if (command.type == command.RC && flight_state_ == FlightState::flying) {
+        set_rc(command.rc_lr, command.rc_fb, command.rc_ud, command.rc_yaw);
+        response->rc = response->OK;
+      } else if (command.type == command.TAKEOFF || command.type == command.LAND ||
+                 command.type == command.STOP || command.type == command.RC) {
+        RCLCPP_WARN(node_->get_logger(), "ignoring command type %d in state '%s'", command.type,
+                    state_strs_[flight_state_]);
+        response->rc = response->ERROR_BUSY;
+      } else {
+        response->rc = response->ERROR_INVALID;
+        response->str = "command type " + std::to_string(command.type) + " is not simulated";
+      }
+    }
+
 #pragma clang diagnostic pop
 
     void cmd_vel_callback(const geometry_msgs::msg::Twist::SharedPtr msg)
@@ -358,8 +414,34 @@ namespace tello_gazebo
       tello_response_pub_->publish(msg);
     }
 
+    // Render only if someone is listening, the camera is the most expensive part of the simulation
+    void gate_camera()
+    {
+      // Sensors are created after models are loaded, so look for the sensor here
+      if (!camera_sensor_) {
+        camera_sensor_ = gazebo::sensors::SensorManager::Instance()->GetSensor(camera_sensor_name_);
+        if (!camera_sensor_) {
+          return;
+        }
+      }
+
+      // Gazebo renders a 0Hz sensor as fast as it can, so --camera_rate 0 is applied here by deactivating it
+      bool active = camera_sensor_->UpdateRate() > 0 &&
+                    (node_->count_subscribers("image_raw") > 0 || node_->count_subscribers("camera_info") > 0);
+
+      if (active != camera_active_) {
+        RCLCPP_INFO(node_->get_logger(), "%s camera", active ? "resume" : "pause");
+        camera_sensor_->SetActive(active);
+        camera_active_ = active;
+      }
+    }
+
     void spin_10Hz()
     {
+      if (!camera_sensor_name_.empty()) {
+        gate_camera();
+      }
+
       rclcpp::Time ros_time = node_->now();
 
       // Wait for ROS time to get reasonable TODO sometimes this never happens